@@ -1,160 +1,972 @@
 #include "wtf/buffer.h"
 
+#include <cstring>
+
+#include "wtf/event.h"
+
 namespace wtf {
 
 OutputBuffer::OutputBuffer(std::ostream* out) : out_{out} {}
 
+namespace {
+uint32_t AlignedLength(uint32_t length) {
+  uint32_t rem = length % OutputBuffer::kAlignment;
+  return rem ? length + OutputBuffer::kAlignment - rem : length;
+}
+}  // namespace
+
 void OutputBuffer::StartChunk(ChunkHeader header, PartHeader* parts,
                               size_t part_count) {
-  static constexpr size_t kChunkHeaderSize = 6 * sizeof(uint32_t);
-  static constexpr size_t kPartHeaderSize = 3 * sizeof(uint32_t);
-
   // Compute layout.
-  uint32_t chunk_length = kChunkHeaderSize + part_count * kPartHeaderSize;
+  uint32_t chunk_length =
+      static_cast<uint32_t>(ChunkLength(parts, part_count));
   uint32_t part_offset = 0;
   for (size_t i = 0; i < part_count; i++) {
-    PartHeader* part = &parts[i];
-    part->offset = part_offset;
-
-    // Compute aligned length.
-    uint32_t aligned_length = part->length;
-    uint32_t rem = aligned_length % kAlignment;
-    if (rem) {
-      aligned_length += kAlignment - rem;
-    }
-
-    chunk_length += aligned_length;
-    part_offset += aligned_length;
+    parts[i].offset = part_offset;
+    part_offset += AlignedLength(parts[i].length);
   }
 
   // Write out chunk header.
-  AppendUint32(header.id);
-  AppendUint32(header.type);
-  AppendUint32(chunk_length);
-  AppendUint32(header.start_time);
-  AppendUint32(header.end_time);
-  AppendUint32(part_count);
+  const uint32_t chunk_words[] = {
+      header.id,         header.type,     chunk_length,
+      header.start_time, header.end_time, static_cast<uint32_t>(part_count),
+  };
+  AppendUint32s(chunk_words, sizeof(chunk_words) / sizeof(uint32_t));
 
   // Write out each part snapshot.
   for (size_t i = 0; i < part_count; i++) {
     PartHeader* part = &parts[i];
-    AppendUint32(part->type);
-    AppendUint32(part->offset);
-    AppendUint32(part->length);
+    const uint32_t part_words[] = {part->type, part->offset, part->length};
+    AppendUint32s(part_words, sizeof(part_words) / sizeof(uint32_t));
+  }
+}
+
+size_t OutputBuffer::ChunkLength(const PartHeader* parts, size_t part_count) {
+  static constexpr size_t kChunkHeaderSize = 6 * sizeof(uint32_t);
+  static constexpr size_t kPartHeaderSize = 3 * sizeof(uint32_t);
+  size_t chunk_length = kChunkHeaderSize + part_count * kPartHeaderSize;
+  for (size_t i = 0; i < part_count; i++) {
+    chunk_length += AlignedLength(parts[i].length);
+  }
+  return chunk_length;
+}
+
+namespace {
+constexpr size_t kInitialStringTableEntries = 64;
+
+// Multiplicative hash consuming 8 bytes at a time. Strings are short, so
+// this is mostly about keeping the dependency chain short.
+uint32_t HashString(const char* str, size_t length) {
+  const uint64_t kMultiplier = 0x9e3779b97f4a7c15ull;
+  uint64_t hash = length * kMultiplier;
+  uint64_t word;
+  while (length >= sizeof(word)) {
+    std::memcpy(&word, str, sizeof(word));
+    hash = (hash ^ word) * kMultiplier;
+    str += sizeof(word);
+    length -= sizeof(word);
+  }
+  if (length) {
+    // Assemble the tail by hand: a variable length memcpy is a libc call.
+    word = 0;
+    for (size_t i = 0; i < length; i++) {
+      word |= static_cast<uint64_t>(static_cast<uint8_t>(str[i])) << (8 * i);
+    }
+    hash = (hash ^ word) * kMultiplier;
   }
+  return static_cast<uint32_t>(hash >> 32);
+}
+}  // namespace
+
+platform::atomic<size_t> StaticString::next_index_{0};
+
+StaticString::StaticString(const char* value)
+    : value_{value}, index_{next_index_.fetch_add(1)} {}
+
+StringTable::StringTable()
+    : entries_(kInitialStringTableEntries), head_{new Block()} {
+  blocks_.push_back(head_);
 }
 
-StringTable::StringTable() = default;
+StringTable::~StringTable() {
+  for (Block* block : blocks_) {
+    delete block;
+  }
+}
 
-int StringTable::GetStringId(const std::string& str) {
-  if (str.empty()) {
+int StringTable::GetStringId(const char* str, size_t length) {
+  if (length == 0) {
     return kEmptyStringId;
   }
 
-  platform::lock_guard<platform::mutex> lock{mu_};
-  auto it = strings_to_id_.find(str);
-  if (it == strings_to_id_.end()) {
-    // New string.
-    int id = strings_.size();
-    strings_.push_back(str);
-    strings_to_id_[str] = id;
-    return id;
-  } else {
-    return it->second;
+  uint32_t hash = HashString(str, length);
+  size_t mask = entries_.size() - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    Entry& entry = entries_[i];
+    if (entry.id == kEmptyStringId) {
+      break;
+    }
+    if (entry.hash == hash) {
+      const std::string& existing =
+          blocks_[entry.id / kBlockSize]->strings[entry.id % kBlockSize];
+      if (existing.size() == length &&
+          std::memcmp(existing.data(), str, length) == 0) {
+        return entry.id;
+      }
+    }
+  }
+
+  // New string. Store it, then publish it to the reader.
+  int id = count_++;
+  if (id / kBlockSize == blocks_.size()) {
+    Block* block = new Block();
+    blocks_.back()->next.store(block, platform::memory_order_release);
+    blocks_.push_back(block);
   }
+  blocks_[id / kBlockSize]->strings[id % kBlockSize].assign(str, length);
+  raw_length_ += length + 1;
+  published_raw_length_.store(raw_length_, platform::memory_order_release);
+
+  // Keep the load factor at or below one half.
+  if (count_ * 2 > entries_.size()) {
+    GrowEntries();
+  }
+  for (size_t i = hash & (entries_.size() - 1);;
+       i = (i + 1) & (entries_.size() - 1)) {
+    if (entries_[i].id == kEmptyStringId) {
+      entries_[i].hash = hash;
+      entries_[i].id = id;
+      break;
+    }
+  }
+  return id;
 }
 
-void StringTable::PopulateHeader(OutputBuffer::PartHeader* header) {
-  platform::lock_guard<platform::mutex> lock{mu_};
+int StringTable::AddStaticString(const StaticString& str) {
+  int id = GetStringId(str.value());
+  if (str.index() >= static_string_ids_.size()) {
+    static_string_ids_.resize(str.index() + 1);
+  }
+  static_string_ids_[str.index()] = id + 1;
+  return id;
+}
 
-  // Compute size.
-  size_t raw_length = 0;
-  for (const auto& s : strings_) {
-    raw_length += s.size() + 1;
+void StringTable::GrowEntries() {
+  std::vector<Entry> old_entries(entries_.size() * 2);
+  old_entries.swap(entries_);
+  size_t mask = entries_.size() - 1;
+  for (const Entry& entry : old_entries) {
+    if (entry.id == kEmptyStringId) {
+      continue;
+    }
+    for (size_t i = entry.hash & mask;; i = (i + 1) & mask) {
+      if (entries_[i].id == kEmptyStringId) {
+        entries_[i] = entry;
+        break;
+      }
+    }
   }
+}
 
-  header->type = 0x30000;
-  header->offset = 0;
-  header->length = raw_length;
+void StringTable::PopulateHeader(OutputBuffer::PartHeader* header) {
+  PopulateDeltaHeader(header, Watermark());
+  header->type = kPartType;
 }
 
 bool StringTable::WriteTo(OutputBuffer::PartHeader* header,
                           OutputBuffer* output_buffer) {
-  platform::lock_guard<platform::mutex> lock{mu_};
+  Watermark watermark;
+  return WriteDeltaTo(header, output_buffer, &watermark);
+}
+
+void StringTable::PopulateDeltaHeader(OutputBuffer::PartHeader* header,
+                                      const Watermark& watermark) {
+  header->type = kDeltaPartType;
+  header->offset = 0;
+  header->length =
+      published_raw_length_.load(platform::memory_order_acquire) -
+      watermark.raw_length;
+}
 
-  // Output up to the previously noted size.
+bool StringTable::WriteDeltaTo(OutputBuffer::PartHeader* header,
+                               OutputBuffer* output_buffer,
+                               Watermark* watermark) {
+  // Output up to the previously noted size. Everything within it was
+  // published by the acquire load in PopulateDeltaHeader(). Blocks before
+  // the watermark are only walked past, not read.
+  size_t count = watermark->count;
   size_t raw_length = 0;
   size_t expected_raw_length = header->length;
-  for (const auto& s : strings_) {
+  Block* block = head_;
+  for (size_t i = 0; i < count / kBlockSize; i++) {
+    block = block->next.load(platform::memory_order_acquire);
+  }
+  for (size_t i = count % kBlockSize; raw_length < expected_raw_length;
+       i++, count++) {
+    if (i == kBlockSize) {
+      block = block->next.load(platform::memory_order_acquire);
+      i = 0;
+    }
+    const std::string& s = block->strings[i];
     raw_length += s.size() + 1;
-    if (raw_length <= expected_raw_length) {
-      output_buffer->Append(s.c_str(), s.size() + 1);  // Write null term.
-      if (raw_length == expected_raw_length) {
-        // Clean end.
-        break;
-      }
-    } else {
+    if (raw_length > expected_raw_length) {
       return false;
     }
+    output_buffer->Append(s.c_str(), s.size() + 1);  // Write null term.
   }
   output_buffer->Align();
+  watermark->count = count;
+  watermark->raw_length += raw_length;
   return true;
 }
 
 void StringTable::Clear() {
+  for (size_t i = 1; i < blocks_.size(); i++) {
+    delete blocks_[i];
+  }
+  blocks_.resize(1);
+  for (auto& s : head_->strings) {
+    s.clear();
+  }
+  head_->next.store(nullptr);
+  entries_.assign(kInitialStringTableEntries, Entry());
+  static_string_ids_.clear();
+  count_ = 0;
+  raw_length_ = 0;
+  published_raw_length_.store(0);
+}
+
+ResourceTable::ResourceTable() : tail_{new Block()}, head_{tail_} {}
+
+ResourceTable::~ResourceTable() {
+  if (memory_budget_) {
+    memory_budget_->Release(allocated_bytes_.load());
+  }
+  Block* block = head_;
+  while (block) {
+    Block* next = block->next.load(platform::memory_order_relaxed);
+    delete block;
+    block = next;
+  }
+}
+
+uint32_t ResourceTable::AddResource(const void* data, size_t length) {
+  if (memory_budget_ && !memory_budget_->TryReserve(length)) {
+    return kDroppedResourceId;
+  }
+  allocated_bytes_.fetch_add(length, platform::memory_order_relaxed);
+  size_t id = count_++;
+  if (id && id % kBlockSize == 0) {
+    Block* block = new Block();
+    tail_->next.store(block, platform::memory_order_release);
+    tail_ = block;
+  }
+  tail_->resources[id % kBlockSize].assign(static_cast<const char*>(data),
+                                           length);
+  published_count_.store(count_, platform::memory_order_release);
+  return static_cast<uint32_t>(id);
+}
+
+void ResourceTable::SetMemoryBudget(MemoryBudget* budget) {
+  size_t allocated_bytes = allocated_bytes_.load();
+  if (memory_budget_) {
+    memory_budget_->Release(allocated_bytes);
+  }
+  memory_budget_ = budget;
+  if (memory_budget_) {
+    memory_budget_->ForceReserve(allocated_bytes);
+  }
+}
+
+void ResourceTable::PopulateHeaders(
+    std::vector<OutputBuffer::PartHeader>* headers) {
+  size_t count = published_count_.load(platform::memory_order_acquire);
+  if (first_id_ && first_id_ < count) {
+    headers->push_back(OutputBuffer::PartHeader{
+        kBasePartType,     // Type.
+        0,                 // Offset.
+        sizeof(uint32_t),  // Length.
+    });
+  }
+  Block* block = head_;
+  for (size_t id = first_id_; id < count; id++) {
+    if (id != head_id_ && id % kBlockSize == 0) {
+      block = block->next.load(platform::memory_order_acquire);
+    }
+    headers->push_back(OutputBuffer::PartHeader{
+        kPartType,  // Type.
+        0,          // Offset.
+        static_cast<uint32_t>(block->resources[id % kBlockSize].size()),
+    });
+  }
+}
+
+bool ResourceTable::WriteTo(
+    const std::vector<OutputBuffer::PartHeader>& headers,
+    OutputBuffer* output_buffer) {
+  // Everything noted in the headers was published by the acquire load in
+  // PopulateHeaders(), and resources never change once added.
+  size_t i = 0;
+  if (!headers.empty() && headers[0].type == kBasePartType) {
+    if (output_buffer) {
+      output_buffer->AppendUint32(static_cast<uint32_t>(first_id_));
+    }
+    i++;
+  }
+  Block* block = head_;
+  for (size_t id = first_id_; i < headers.size(); i++, id++) {
+    if (id != head_id_ && id % kBlockSize == 0) {
+      block = block->next.load(platform::memory_order_acquire);
+    }
+    const std::string& resource = block->resources[id % kBlockSize];
+    if (resource.size() != headers[i].length) {
+      return false;
+    }
+    if (output_buffer) {
+      output_buffer->Append(resource.data(), resource.size());
+      output_buffer->Align();
+    }
+  }
+
+  // Free what clearing saves have written. A block is only deleted once the
+  // writer has moved on from it.
+  size_t released_bytes = 0;
+  for (; first_id_ < release_count_; first_id_++) {
+    if (first_id_ != head_id_ && first_id_ % kBlockSize == 0) {
+      Block* next = head_->next.load(platform::memory_order_acquire);
+      delete head_;
+      head_ = next;
+      head_id_ = first_id_;
+    }
+    std::string& resource = head_->resources[first_id_ % kBlockSize];
+    released_bytes += resource.size();
+    std::string().swap(resource);
+  }
+  if (first_id_ != head_id_ && first_id_ % kBlockSize == 0) {
+    Block* next = head_->next.load(platform::memory_order_acquire);
+    if (next) {
+      delete head_;
+      head_ = next;
+      head_id_ = first_id_;
+    }
+  }
+  allocated_bytes_.fetch_sub(released_bytes, platform::memory_order_relaxed);
+  if (memory_budget_) {
+    memory_budget_->Release(released_bytes);
+  }
+  return true;
+}
+
+bool MemoryBudget::TryReserve(size_t bytes) {
+  size_t used_bytes = used_bytes_.load(platform::memory_order_relaxed);
+  do {
+    size_t limit_bytes = limit_bytes_.load(platform::memory_order_relaxed);
+    if (limit_bytes && used_bytes + bytes > limit_bytes) {
+      return false;
+    }
+  } while (!used_bytes_.compare_exchange_weak(used_bytes, used_bytes + bytes,
+                                              platform::memory_order_relaxed));
+  return true;
+}
+
+void MemoryBudget::ForceReserve(size_t bytes) {
+  used_bytes_.fetch_add(bytes, platform::memory_order_relaxed);
+}
+
+void MemoryBudget::Release(size_t bytes) {
+  used_bytes_.fetch_sub(bytes, platform::memory_order_relaxed);
+}
+
+namespace {
+void DeleteChunkList(EventBuffer::Chunk* chunk) {
+  while (chunk) {
+    EventBuffer::Chunk* next_chunk = chunk->next;
+    delete chunk;
+    chunk = next_chunk;
+  }
+}
+}  // namespace
+
+EventBuffer::ChunkPool::ChunkPool(size_t max_chunk_count,
+                                  MemoryBudget* memory_budget)
+    : max_chunk_count_{max_chunk_count}, memory_budget_{memory_budget} {}
+
+EventBuffer::ChunkPool::~ChunkPool() {
+  if (memory_budget_) {
+    memory_budget_->Release(chunk_count_ * chunk_limit_ * sizeof(uint32_t));
+  }
+  DeleteChunkList(chunks_);
+}
+
+size_t EventBuffer::ChunkPool::chunk_count() {
   platform::lock_guard<platform::mutex> lock{mu_};
-  strings_.clear();
-  strings_to_id_.clear();
+  return chunk_count_;
+}
+
+void EventBuffer::ChunkPool::Trim() {
+  // Unlink under the lock and delete after it, so that writers trying to
+  // take a chunk meanwhile are not held up.
+  Chunk* trimmed = nullptr;
+  {
+    platform::lock_guard<platform::mutex> lock{mu_};
+    while (chunks_ && OverBudget()) {
+      Chunk* chunk = chunks_;
+      chunks_ = chunk->next.load(platform::memory_order_relaxed);
+      chunk_count_--;
+      memory_budget_->Release(chunk->limit * sizeof(uint32_t));
+      chunk->next.store(trimmed, platform::memory_order_relaxed);
+      trimmed = chunk;
+    }
+  }
+  DeleteChunkList(trimmed);
+}
+
+bool EventBuffer::ChunkPool::OverBudget() {
+  if (!memory_budget_) {
+    return false;
+  }
+  size_t limit_bytes = memory_budget_->limit_bytes();
+  return limit_bytes && memory_budget_->used_bytes() > limit_bytes;
+}
+
+EventBuffer::Chunk* EventBuffer::ChunkPool::Take(size_t limit) {
+  // Writers never wait on the lock: if another thread holds it, they
+  // allocate instead.
+  if (!mu_.try_lock()) {
+    return nullptr;
+  }
+  Chunk* chunk = chunks_;
+  if (!chunk || limit != chunk_limit_) {
+    mu_.unlock();
+    return nullptr;
+  }
+  chunks_ = chunk->next.load(platform::memory_order_relaxed);
+  chunk_count_--;
+  mu_.unlock();
+
+  // The taker publishes the chunk as it would a new one.
+  chunk->size = 0;
+  chunk->published_size.store(0, platform::memory_order_relaxed);
+  chunk->next.store(nullptr, platform::memory_order_relaxed);
+  chunk->skip_count = 0;
+  chunk->skip_time_nanos = 0;
+  chunk->base_time_nanos = 0;
+  chunk->needs_timebase = false;
+  return chunk;
+}
+
+size_t EventBuffer::ChunkPool::Give(Chunk* chunks) {
+  // Chunks that do not fit are deleted after unlocking, as in Trim().
+  size_t pooled_bytes = 0;
+  Chunk* rejected = nullptr;
+  {
+    platform::lock_guard<platform::mutex> lock{mu_};
+    while (chunks) {
+      Chunk* chunk = chunks;
+      chunks = chunk->next.load(platform::memory_order_relaxed);
+      if (!chunk_count_) {
+        chunk_limit_ = chunk->limit;
+      }
+      if (chunk_count_ < max_chunk_count_ && chunk->limit == chunk_limit_ &&
+          !OverBudget()) {
+        chunk->next.store(chunks_, platform::memory_order_relaxed);
+        chunks_ = chunk;
+        chunk_count_++;
+        pooled_bytes += chunk->limit * sizeof(uint32_t);
+      } else {
+        chunk->next.store(rejected, platform::memory_order_relaxed);
+        rejected = chunk;
+      }
+    }
+  }
+  DeleteChunkList(rejected);
+  return pooled_bytes;
 }
 
-EventBuffer::EventBuffer(size_t chunk_size_bytes) {
+EventBuffer::EventBuffer(size_t chunk_size_bytes, ChunkPool* chunk_pool) {
   if (chunk_size_bytes < kMinimumChunkSizeBytes) {
     chunk_size_bytes = kMinimumChunkSizeBytes;
   }
   chunk_limit_ = chunk_size_bytes / sizeof(uint32_t);
+  size_t bytes = chunk_limit_ * sizeof(uint32_t);
 
-  head_ = current_ = new Chunk(chunk_limit_);
+  Chunk* chunk = nullptr;
+  if (chunk_pool) {
+    chunk_pool_ = chunk_pool;
+    memory_budget_ = chunk_pool->memory_budget_;
+    resource_table_.SetMemoryBudget(memory_budget_);
+    chunk = chunk_pool->Take(chunk_limit_);
+    if (!chunk && memory_budget_) {
+      memory_budget_->ForceReserve(bytes);
+    }
+  }
+  head_ = current_ = chunk ? chunk : new Chunk(chunk_limit_);
+  allocated_bytes_.store(bytes, platform::memory_order_relaxed);
+
+  creation_time_nanos_ = last_event_time_nanos_ =
+      PlatformGetTimestampNanos64();
+  head_->base_time_nanos = creation_time_nanos_;
 }
 
 EventBuffer::~EventBuffer() {
-  Chunk* chunk = head_;
-  while (chunk) {
-    Chunk* next_chunk = chunk->next;
-    delete chunk;
-    chunk = next_chunk;
+  if (chunk_pool_ && chunk_pool_->memory_budget_ == memory_budget_) {
+    size_t pooled_bytes = chunk_pool_->Give(head_) +
+                          chunk_pool_->Give(free_chunks_) +
+                          chunk_pool_->Give(recycled_chunks_.load());
+    allocated_bytes_.fetch_sub(pooled_bytes);
+  } else {
+    DeleteChunkList(head_);
+    DeleteChunkList(free_chunks_);
+    DeleteChunkList(recycled_chunks_.load());
+  }
+  if (memory_budget_) {
+    memory_budget_->Release(allocated_bytes_.load());
+  }
+}
+
+void EventBuffer::SetMemoryBudget(MemoryBudget* budget) {
+  size_t allocated_bytes = allocated_bytes_.load();
+  if (memory_budget_) {
+    memory_budget_->Release(allocated_bytes);
+  }
+  memory_budget_ = budget;
+  if (memory_budget_) {
+    memory_budget_->ForceReserve(allocated_bytes);
+  }
+  resource_table_.SetMemoryBudget(budget);
+}
+
+void EventBuffer::ReserveChunks(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    Chunk* chunk = NewChunk();
+    if (!chunk) {
+      break;
+    }
+    chunk->next.store(free_chunks_, platform::memory_order_relaxed);
+    free_chunks_ = chunk;
+  }
+}
+
+EventBuffer::Chunk* EventBuffer::NewChunk() {
+  size_t bytes = chunk_limit_ * sizeof(uint32_t);
+  if (chunk_pool_ && chunk_pool_->memory_budget_ == memory_budget_) {
+    Chunk* chunk = chunk_pool_->Take(chunk_limit_);
+    if (chunk) {
+      // Already charged to the budget.
+      allocated_bytes_.fetch_add(bytes);
+      return chunk;
+    }
+  }
+  if (memory_budget_ && !memory_budget_->TryReserve(bytes)) {
+    return nullptr;
+  }
+  allocated_bytes_.fetch_add(bytes);
+  return new Chunk(chunk_limit_);
+}
+
+EventBuffer::Chunk* EventBuffer::AllocateChunk() {
+  if (!free_chunks_) {
+    free_chunks_ = recycled_chunks_.exchange(nullptr,
+                                             platform::memory_order_acquire);
+    if (!free_chunks_) {
+      return NewChunk();
+    }
   }
+
+  // Pop and reset. The chunk is not yet visible to the reader so relaxed
+  // stores suffice: it is published by the release store to 'next' in
+  // ExpandAndAddSlots().
+  Chunk* chunk = free_chunks_;
+  free_chunks_ = chunk->next.load(platform::memory_order_relaxed);
+  chunk->size = 0;
+  chunk->published_size.store(0, platform::memory_order_relaxed);
+  chunk->next.store(nullptr, platform::memory_order_relaxed);
+  chunk->skip_count = 0;
+  chunk->skip_time_nanos = 0;
+  return chunk;
+}
+
+void EventBuffer::RecycleChunk(Chunk* chunk) {
+  // When the budget is exhausted, hand the memory back so that other buffers
+  // can use it rather than keeping it pooled here.
+  if (memory_budget_) {
+    size_t bytes = chunk->limit * sizeof(uint32_t);
+    size_t limit_bytes = memory_budget_->limit_bytes();
+    if (limit_bytes && memory_budget_->used_bytes() + bytes > limit_bytes) {
+      delete chunk;
+      allocated_bytes_.fetch_sub(bytes, platform::memory_order_relaxed);
+      memory_budget_->Release(bytes);
+      return;
+    }
+  }
+
+  Chunk* top = recycled_chunks_.load(platform::memory_order_relaxed);
+  do {
+    chunk->next.store(top, platform::memory_order_relaxed);
+  } while (!recycled_chunks_.compare_exchange_weak(
+      top, chunk, platform::memory_order_release));
 }
 
 void EventBuffer::FreezePrefixSlots() {
   Chunk* chunk = current_;
-  frozen_prefix_slots_.resize(chunk->size);
-  for (size_t i = 0; i < frozen_prefix_slots_.size(); i++) {
-    frozen_prefix_slots_[i] = chunk->slots[i];
+  if (compact_encoding_) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(chunk->slots);
+    frozen_prefix_bytes_.assign(bytes, bytes + chunk->size);
+  } else {
+    frozen_prefix_slots_.resize(chunk->size);
+    for (size_t i = 0; i < frozen_prefix_slots_.size(); i++) {
+      frozen_prefix_slots_[i] = chunk->slots[i];
+    }
   }
   chunk->size = 0;
   chunk->published_size = 0;
+  chunk->base_time_nanos = last_event_time_nanos_;
+}
+
+void EventBuffer::DiscardOldestChunks() {
+  // If a reader is mid snapshot, leave the list alone and grow instead.
+  if (!read_mu_.try_lock()) {
+    return;
+  }
+  size_t chunk_count = chunk_count_.load(platform::memory_order_relaxed);
+  while (chunk_count >= max_chunk_count_ && head_ != current_) {
+    Chunk* chunk = head_;
+    head_ = chunk->next.load(platform::memory_order_relaxed);
+    chunk->next.store(free_chunks_, platform::memory_order_relaxed);
+    free_chunks_ = chunk;
+    chunk_count = chunk_count_.fetch_sub(1, platform::memory_order_relaxed) - 1;
+    discarded_chunk_count_.store(
+        discarded_chunk_count_.load(platform::memory_order_relaxed) + 1,
+        platform::memory_order_relaxed);
+  }
+  read_mu_.unlock();
 }
 
 uint32_t* EventBuffer::ExpandAndAddSlots(size_t count) {
   // Publish the final size of the old chunk.
   Flush();
 
+  // In flight recorder mode, make room by overwriting the oldest data.
+  if (max_chunk_count_ &&
+      chunk_count_.load(platform::memory_order_relaxed) >= max_chunk_count_) {
+    DiscardOldestChunks();
+  }
+
   // Publish that we have a new 'count' sized chunk.
   // This must come after the store to published_size as it signifies that no
   // further updates will be made to published_size.
-  Chunk* new_chunk = new Chunk(chunk_limit_);
+  Chunk* new_chunk = AllocateChunk();
+  if (!new_chunk) {
+    // Over budget: drop the event. The next overflow will try again, which
+    // succeeds once a clearing save has released chunks.
+    dropped_event_count_.store(
+        dropped_event_count_.load(platform::memory_order_relaxed) + 1,
+        platform::memory_order_relaxed);
+    dropping_events_ = true;
+    return drop_slots_;
+  }
   new_chunk->size = count;
+  new_chunk->base_time_nanos = last_event_time_nanos_;
+  new_chunk->needs_timebase = dropping_events_;
+  dropping_events_ = false;
+  chunk_count_.fetch_add(1);
   current_->next.store(new_chunk, platform::memory_order_release);
 
   // Make new chunk current (does not modify shared state).
   current_ = new_chunk;
+  chunk_generation_++;
 
   return new_chunk->slots;
 }
 
-void EventBuffer::PopulateHeader(OutputBuffer::PartHeader* header) {
-  size_t published_slot_count = 0;
+void EventBuffer::AddTimebase(uint64_t time) {
+  uint32_t* slots = AddSlots(3);
+  slots[0] = StandardEvents::kTimebaseEventId;
+  slots[1] = static_cast<uint32_t>(time);
+  slots[2] = static_cast<uint32_t>(time >> 32);
+}
+
+namespace {
+// Compact encoding.
+// Each event is a sequence of little endian base 128 varints:
+//   (wire_id << 4) | min(arg_slot_count, 15)
+//   arg_slot_count, only if it is 15 or more
+//   nanoseconds since the previous event
+//   one per argument slot
+// A wtf.trace#timebase event instead carries the full time as two argument
+// slots (low, high) and resets the running time to it. The reader writes
+// those with fixed 5 byte varints so that they are the same size as in the
+// slot encoding.
+constexpr size_t kCompactInlineArgCount = 15;
+
+uint8_t* EncodeVarint(uint8_t* p, uint64_t value) {
+  while (value >= 0x80) {
+    *p++ = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(value);
+  return p;
+}
+
+// Encodes a 32 bit value in exactly 5 bytes (varints may have redundant
+// continuation bytes).
+uint8_t* EncodeFixedVarint32(uint8_t* p, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    *p++ = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  *p++ = static_cast<uint8_t>(value);
+  return p;
+}
+
+const uint8_t* DecodeVarint(const uint8_t* p, uint64_t* value) {
+  uint64_t result = 0;
+  int shift = 0;
+  uint8_t byte;
+  do {
+    byte = *p++;
+    result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  *value = result;
+  return p;
+}
+
+uint8_t* EncodeCompactEventHeader(uint8_t* p, uint32_t wire_id,
+                                  size_t arg_count, uint64_t delta_time) {
+  if (arg_count < kCompactInlineArgCount) {
+    p = EncodeVarint(p, (static_cast<uint64_t>(wire_id) << 4) | arg_count);
+  } else {
+    p = EncodeVarint(p, (static_cast<uint64_t>(wire_id) << 4) |
+                            kCompactInlineArgCount);
+    p = EncodeVarint(p, arg_count);
+  }
+  return EncodeVarint(p, delta_time);
+}
+
+// Decodes the event at 'p', advancing 'time' to its time. Returns the start
+// of the next event.
+const uint8_t* DecodeCompactEvent(const uint8_t* p, uint64_t* time) {
+  uint64_t header;
+  uint64_t arg_count;
+  uint64_t delta_time;
+  p = DecodeVarint(p, &header);
+  arg_count = header & kCompactInlineArgCount;
+  if (arg_count == kCompactInlineArgCount) {
+    p = DecodeVarint(p, &arg_count);
+  }
+  p = DecodeVarint(p, &delta_time);
+  *time += delta_time;
+  if ((header >> 4) == StandardEvents::kTimebaseEventId && arg_count == 2) {
+    uint64_t low_time;
+    uint64_t high_time;
+    p = DecodeVarint(p, &low_time);
+    p = DecodeVarint(p, &high_time);
+    *time = (high_time << 32) | low_time;
+    return p;
+  }
+  for (uint64_t i = 0; i < arg_count; i++) {
+    uint64_t arg;
+    p = DecodeVarint(p, &arg);
+  }
+  return p;
+}
+}  // namespace
+
+void EventBuffer::AddCompactEvent(uint32_t wire_id, const uint32_t* args,
+                                  size_t count) {
+  uint64_t now = PlatformGetTimestampNanos64();
+  Chunk* chunk = current_;
+  if (chunk->size + MaximumCompactEventBytes(count) >
+      chunk->limit * sizeof(uint32_t)) {
+    if (ExpandAndAddSlots(0) == drop_slots_) {
+      // The next delta stays relative to the last written event.
+      return;
+    }
+    chunk = current_;
+  }
+  uint8_t* start = reinterpret_cast<uint8_t*>(chunk->slots) + chunk->size;
+  uint8_t* p = EncodeCompactEventHeader(start, wire_id, count,
+                                        now - last_event_time_nanos_);
+  for (size_t i = 0; i < count; i++) {
+    p = EncodeVarint(p, args[i]);
+  }
+  last_event_time_nanos_ = now;
+  chunk->size += p - start;
+}
+
+namespace {
+// Reconstructs a full timestamp from the low 32 bits of one that is known to
+// be in [reference, reference + 2^32).
+uint64_t UnwrapTime(uint64_t reference, uint32_t low_time) {
+  return reference + static_cast<uint32_t>(low_time -
+                                           static_cast<uint32_t>(reference));
+}
+
+// Returns a time that the first unread event in a chunk can be unwrapped
+// against (or in compact encoding, that its time delta is relative to). At
+// the start of the chunk this is its base time. In compact encoding, clearing
+// writes record the exact time of the last event that they skipped.
+// Otherwise, the events before skip_count were published before the save at
+// skip_time_nanos, so the next one is either at most kTimebaseIntervalNanos
+// after it or is a timebase itself. Allow the rest of the range for events
+// that were stamped before that save but published after it.
+uint64_t GetRangeStartTime(EventBuffer::Chunk* chunk, bool compact_encoding) {
+  if (!chunk->skip_count) {
+    return chunk->base_time_nanos;
+  }
+  if (compact_encoding) {
+    return chunk->skip_time_nanos;
+  }
+  const uint64_t kLookbackNanos =
+      (1ull << 32) - EventBuffer::kTimebaseIntervalNanos;
+  return chunk->skip_time_nanos > kLookbackNanos
+             ? chunk->skip_time_nanos - kLookbackNanos
+             : 0;
+}
+
+// Returns the timestamp of the first unread event in a chunk, or false if
+// the chunk has no published events.
+bool GetFirstEventTime(EventBuffer::Chunk* chunk, bool compact_encoding,
+                       uint64_t* time) {
+  size_t published_size =
+      chunk->published_size.load(platform::memory_order_acquire);
+  if (compact_encoding) {
+    if (published_size <= chunk->skip_count) {
+      return false;
+    }
+    *time = GetRangeStartTime(chunk, true);
+    DecodeCompactEvent(
+        reinterpret_cast<const uint8_t*>(chunk->slots) + chunk->skip_count,
+        time);
+    return true;
+  }
+  const uint32_t* slots = chunk->slots + chunk->skip_count;
+  if (published_size < chunk->skip_count + 2) {
+    return false;
+  }
+  if (slots[0] == StandardEvents::kTimebaseEventId) {
+    *time = (static_cast<uint64_t>(slots[2]) << 32) | slots[1];
+  } else {
+    *time = UnwrapTime(GetRangeStartTime(chunk, false), slots[1]);
+  }
+  return true;
+}
+
+// Bytes taken by AppendTimebase() in either encoding.
+constexpr size_t kTimebaseBytes = 3 * sizeof(uint32_t);
+
+void AppendTimebase(OutputBuffer* output_buffer, bool compact_encoding,
+                    uint64_t time) {
+  if (compact_encoding) {
+    uint8_t bytes[kTimebaseBytes];
+    uint8_t* p = EncodeCompactEventHeader(
+        bytes, StandardEvents::kTimebaseEventId, 2, 0);
+    p = EncodeFixedVarint32(p, static_cast<uint32_t>(time));
+    EncodeFixedVarint32(p, static_cast<uint32_t>(time >> 32));
+    output_buffer->Append(bytes, kTimebaseBytes);
+    return;
+  }
+  uint32_t slots[3] = {StandardEvents::kTimebaseEventId,
+                       static_cast<uint32_t>(time),
+                       static_cast<uint32_t>(time >> 32)};
+  output_buffer->AppendUint32s(slots, 3);
+}
+
+// Bytes taken by AppendDiscontinuity().
+size_t GetDiscontinuityBytes(bool compact_encoding) {
+  return kTimebaseBytes + (compact_encoding ? 2 : 2 * sizeof(uint32_t));
+}
+
+// Appends a wtf.trace#discontinuity event at 'time', preceded by a timebase.
+void AppendDiscontinuity(OutputBuffer* output_buffer, bool compact_encoding,
+                         uint64_t time) {
+  AppendTimebase(output_buffer, compact_encoding, time);
+  if (compact_encoding) {
+    uint8_t bytes[2];
+    EncodeCompactEventHeader(bytes, StandardEvents::kDiscontinuityEventId, 0,
+                             0);
+    output_buffer->Append(bytes, 2);
+    return;
+  }
+  uint32_t slots[2] = {StandardEvents::kDiscontinuityEventId,
+                       static_cast<uint32_t>(time)};
+  output_buffer->AppendUint32s(slots, 2);
+}
+
+// Bytes taken by AppendDroppedEvents().
+size_t GetDroppedEventsBytes(bool compact_encoding) {
+  return kTimebaseBytes + (compact_encoding ? 7 : 3 * sizeof(uint32_t));
+}
+
+// Appends a wtf.trace#dropped event at 'time', preceded by a timebase.
+void AppendDroppedEvents(OutputBuffer* output_buffer, bool compact_encoding,
+                         uint64_t time, uint32_t count) {
+  AppendTimebase(output_buffer, compact_encoding, time);
+  if (compact_encoding) {
+    uint8_t bytes[7];
+    uint8_t* p = EncodeCompactEventHeader(
+        bytes, StandardEvents::kDroppedEventsEventId, 1, 0);
+    EncodeFixedVarint32(p, count);
+    output_buffer->Append(bytes, 7);
+    return;
+  }
+  uint32_t slots[3] = {StandardEvents::kDroppedEventsEventId,
+                       static_cast<uint32_t>(time), count};
+  output_buffer->AppendUint32s(slots, 3);
+}
+}  // namespace
+
+void EventBuffer::PopulateHeader(OutputBuffer::PartHeader* header,
+                                 uint32_t max_age_micros) {
+  // Loaded ahead of the published sizes, so that a clearing write frees only
+  // resources whose events it covers.
+  snapshot_flushed_resource_count_ = resource_table_.flushed_count();
   Chunk* chunk = head_;
+
+  // Skip leading chunks whose successor starts before the cutoff: every
+  // event in them is older than max_age_micros.
+  bool skipped_chunks = false;
+  if (max_age_micros) {
+    uint64_t now = PlatformGetTimestampNanos64();
+    uint64_t max_age_nanos = static_cast<uint64_t>(max_age_micros) * 1000;
+    uint64_t cutoff = now > max_age_nanos ? now - max_age_nanos : 0;
+    while (true) {
+      Chunk* next_chunk = chunk->next.load(platform::memory_order_acquire);
+      uint64_t next_time;
+      if (!next_chunk ||
+          !GetFirstEventTime(next_chunk, compact_encoding_, &next_time) ||
+          next_time > cutoff) {
+        break;
+      }
+      chunk = next_chunk;
+      skipped_chunks = true;
+    }
+  }
+  snapshot_start_chunk_ = chunk;
+  snapshot_discarded_chunk_count_ = discarded_chunk_count();
+  snapshot_has_discontinuity_ =
+      skipped_chunks ||
+      snapshot_discarded_chunk_count_ != cleared_discarded_chunk_count_;
+  snapshot_dropped_event_count_ = dropped_event_count();
+
+  // Sizes in chunks are in slots, or bytes in compact encoding.
+  const size_t unit_bytes = compact_encoding_ ? 1 : sizeof(uint32_t);
+  size_t length = 0;
+  size_t prefix_bytes = compact_encoding_
+                            ? frozen_prefix_bytes_.size()
+                            : frozen_prefix_slots_.size() * sizeof(uint32_t);
+  if (prefix_bytes) {
+    length += kTimebaseBytes + prefix_bytes;
+  }
+  if (snapshot_has_discontinuity_) {
+    length += GetDiscontinuityBytes(compact_encoding_);
+  }
+  if (snapshot_dropped_event_count_ != cleared_dropped_event_count_) {
+    length += GetDroppedEventsBytes(compact_encoding_);
+  }
+  bool first_range = true;
+  snapshot_start_time_ = 0;
   while (chunk) {
     // The next chunk must be loaded prior to loading the published size of
     // the current chunk, otherwise, there is the potential for an asynchronous
@@ -162,38 +974,103 @@ void EventBuffer::PopulateHeader(OutputBuffer::PartHeader* header) {
     // final updates to published_size on this chunk prior to that being
     // visible.
     Chunk* next_chunk = chunk->next.load(platform::memory_order_acquire);
-    published_slot_count +=
+    size_t remaining =
         chunk->published_size.load(platform::memory_order_acquire) -
         chunk->skip_count;
+    if (remaining) {
+      // Must match the condition in WriteTo().
+      if (first_range || chunk->needs_timebase || compact_encoding_) {
+        length += kTimebaseBytes;
+      }
+      if (first_range) {
+        GetFirstEventTime(chunk, compact_encoding_, &snapshot_start_time_);
+        first_range = false;
+      }
+      length += remaining * unit_bytes;
+    }
 
     chunk = next_chunk;
   }
 
-  header->type = 0x20002;
+  // This must be read after the published sizes: clearing writes record it
+  // as the point by which everything they skip had been written.
+  snapshot_time_ = PlatformGetTimestampNanos64();
+  if (first_range) {
+    snapshot_start_time_ = snapshot_time_;
+  }
+
+  header->type = compact_encoding_ ? 0x20003 : 0x20002;
   header->offset = 0;
-  header->length =
-      (frozen_prefix_slots().size() + published_slot_count) * sizeof(uint32_t);
+  header->length = length;
 }
 
 bool EventBuffer::WriteTo(OutputBuffer::PartHeader* header,
                           OutputBuffer* output_buffer,
                           bool clear_written_data) {
-  Chunk* chunk = head_;
-  size_t count = header->length / sizeof(uint32_t);
+  Chunk* chunk = snapshot_start_chunk_ ? snapshot_start_chunk_ : head_;
+  const size_t unit_bytes = compact_encoding_ ? 1 : sizeof(uint32_t);
+  size_t length = header->length;
 
   // Write the frozen prefix.
-  if (count < frozen_prefix_slots_.size()) {
-    return false;
+  size_t prefix_bytes = compact_encoding_
+                            ? frozen_prefix_bytes_.size()
+                            : frozen_prefix_slots_.size() * sizeof(uint32_t);
+  if (prefix_bytes) {
+    if (length < kTimebaseBytes + prefix_bytes) {
+      return false;
+    }
+    length -= kTimebaseBytes + prefix_bytes;
+    if (output_buffer) {
+      AppendTimebase(output_buffer, compact_encoding_, creation_time_nanos_);
+      if (compact_encoding_) {
+        output_buffer->Append(frozen_prefix_bytes_.data(), prefix_bytes);
+      } else {
+        output_buffer->AppendUint32s(frozen_prefix_slots_.data(),
+                                     frozen_prefix_slots_.size());
+      }
+    }
   }
-  count -= frozen_prefix_slots_.size();
-  for (uint32_t prefix_value : frozen_prefix_slots_) {
+
+  // Mark where data was lost, ahead of the oldest event that was retained.
+  if (snapshot_has_discontinuity_) {
+    if (length < GetDiscontinuityBytes(compact_encoding_)) {
+      return false;
+    }
+    length -= GetDiscontinuityBytes(compact_encoding_);
     if (output_buffer) {
-      output_buffer->AppendUint32(prefix_value);
+      AppendDiscontinuity(output_buffer, compact_encoding_,
+                          snapshot_start_time_);
+    }
+  }
+
+  // Reserve room for the dropped event count, which trails the data.
+  size_t dropped_event_count =
+      snapshot_dropped_event_count_ - cleared_dropped_event_count_;
+  if (dropped_event_count) {
+    if (length < GetDroppedEventsBytes(compact_encoding_)) {
+      return false;
     }
+    length -= GetDroppedEventsBytes(compact_encoding_);
   }
 
+  // Drop chunks that were left out of the snapshot.
+  if (clear_written_data) {
+    while (head_ != chunk) {
+      Chunk* next_chunk = head_->next.load(platform::memory_order_acquire);
+      RecycleChunk(head_);
+      chunk_count_.fetch_sub(1, platform::memory_order_relaxed);
+      head_ = next_chunk;
+    }
+    cleared_discarded_chunk_count_ = snapshot_discarded_chunk_count_;
+    cleared_dropped_event_count_ = snapshot_dropped_event_count_;
+    resource_table_.ReleaseBelow(snapshot_flushed_resource_count_);
+  }
+  snapshot_start_chunk_ = nullptr;
+  snapshot_has_discontinuity_ = false;
+
   // Write the main part of the buffer chunk by chunk.
-  while (count > 0) {
+  bool first_range = true;
+  while (length > 0) {
     if (!chunk) {
       // Size mismatch.
       return false;
@@ -208,34 +1085,67 @@ bool EventBuffer::WriteTo(OutputBuffer::PartHeader* header,
 
     size_t skip_count = chunk->skip_count;
     size_t remaining = published_size - skip_count;
-    if (remaining > count) {
-      remaining = count;
-    }
+    uint64_t range_start_time = GetRangeStartTime(chunk, compact_encoding_);
 
-    // Write the remaining slots.
-    for (size_t i = 0; i < remaining; i++) {
+    // Give the reader a time to unwrap against if the events do not follow
+    // on from ones that it has already seen. Compact time deltas are relative
+    // to the previous event in the same chunk, so each chunk needs one.
+    if (remaining &&
+        (first_range || chunk->needs_timebase || compact_encoding_)) {
+      if (length < kTimebaseBytes) {
+        return false;
+      }
+      length -= kTimebaseBytes;
       if (output_buffer) {
-        output_buffer->AppendUint32(chunk->slots[skip_count + i]);
+        AppendTimebase(output_buffer, compact_encoding_, range_start_time);
       }
+      first_range = false;
+    }
+    if (remaining * unit_bytes > length) {
+      remaining = length / unit_bytes;
+    }
+
+    // Write the remaining data as one contiguous span.
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(chunk->slots) +
+                          skip_count * unit_bytes;
+    if (output_buffer && remaining > 0) {
+      output_buffer->Append(data, remaining * unit_bytes);
     }
-    count -= remaining;
+    length -= remaining * unit_bytes;
 
     // Clear data and reset head if applicable.
     if (clear_written_data) {
+      if (compact_encoding_) {
+        uint64_t time = range_start_time;
+        for (const uint8_t* p = data; p < data + remaining;) {
+          p = DecodeCompactEvent(p, &time);
+        }
+        chunk->skip_time_nanos = time;
+      } else {
+        chunk->skip_time_nanos = snapshot_time_;
+      }
       chunk->skip_count += remaining;
       // If the writer is done with this one (next_chunk != nullptr),
-      // we are moving on to the next chunk (count > 0), and we are on the
+      // we are moving on to the next chunk (length > 0), and we are on the
       // head_, then kill it and reset the head.
-      if (next_chunk && count > 0 && chunk == head_) {
-        // TODO(laurenzo): Put these back into a thread local pool and re-use
-        // them.
-        delete head_;
+      if (next_chunk && length > 0 && chunk == head_) {
         head_ = next_chunk;
+        RecycleChunk(chunk);
+        chunk_count_.fetch_sub(1, platform::memory_order_relaxed);
       }
     }
 
     chunk = next_chunk;
   }
+
+  if (output_buffer) {
+    if (dropped_event_count) {
+      AppendDroppedEvents(output_buffer, compact_encoding_, snapshot_time_,
+                          static_cast<uint32_t>(dropped_event_count));
+    }
+    // Compact data need not fill the last word.
+    output_buffer->Align();
+  }
   return true;
 }
 
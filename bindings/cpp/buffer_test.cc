@@ -1,10 +1,13 @@
 #include "wtf/buffer.h"
 
+#include <unistd.h>
+
 #include <cstdlib>
 #include <sstream>
 #include <vector>
 
 #include "gtest/gtest.h"
+#include "wtf/event.h"
 
 #ifndef TMP_PREFIX
 #define TMP_PREFIX ""
@@ -26,6 +29,67 @@ class BufferTest : public ::testing::Test {
     return slots;
   }
 
+  // Removes the wtf.trace#timebase event at 'index', returning its time.
+  uint64_t TakeTimebase(std::vector<uint32_t>* slots, size_t index) {
+    if (index + 3 > slots->size()) {
+      ADD_FAILURE() << "No room for a timebase at " << index;
+      return 0;
+    }
+    EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kTimebaseEventId),
+              (*slots)[index]);
+    uint64_t time = (static_cast<uint64_t>((*slots)[index + 2]) << 32) |
+                    (*slots)[index + 1];
+    slots->erase(slots->begin() + index, slots->begin() + index + 3);
+    return time;
+  }
+
+  struct CompactEvent {
+    uint32_t wire_id;
+    uint64_t time;
+    std::vector<uint32_t> args;
+  };
+
+  // Decodes compact encoding the way that a reader would, applying (and
+  // returning) timebases.
+  std::vector<CompactEvent> DecodeCompactEvents(const std::string& s) {
+    std::vector<CompactEvent> events;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(s.data());
+    const uint8_t* end = p + s.size();
+    auto read_varint = [&p]() {
+      uint64_t value = 0;
+      int shift = 0;
+      uint8_t byte;
+      do {
+        byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        shift += 7;
+      } while (byte & 0x80);
+      return value;
+    };
+    uint64_t time = 0;
+    while (p < end) {
+      CompactEvent event;
+      uint64_t header = read_varint();
+      event.wire_id = static_cast<uint32_t>(header >> 4);
+      uint64_t arg_count = header & 15;
+      if (arg_count == 15) {
+        arg_count = read_varint();
+      }
+      time += read_varint();
+      for (uint64_t i = 0; i < arg_count; i++) {
+        event.args.push_back(static_cast<uint32_t>(read_varint()));
+      }
+      if (event.wire_id == StandardEvents::kTimebaseEventId) {
+        EXPECT_EQ(2u, event.args.size());
+        time = (static_cast<uint64_t>(event.args[1]) << 32) | event.args[0];
+      }
+      event.time = time;
+      events.push_back(event);
+    }
+    EXPECT_EQ(end, p);
+    return events;
+  }
+
   bool DummyWriteAndClearEventBuffer(EventBuffer* eb) {
     OutputBuffer::PartHeader part_header;
     eb->PopulateHeader(&part_header);
@@ -45,6 +109,77 @@ TEST_F(BufferTest, StringTableDedups) {
   EXPECT_EQ(id1 + 1, id2);
 }
 
+TEST_F(BufferTest, StringTableManyStrings) {
+  // Enough strings to span several blocks and grow the lookup table.
+  StringTable st;
+  std::string expected;
+  for (int i = 0; i < 1000; i++) {
+    std::string s = "s" + std::to_string(i);
+    EXPECT_EQ(i, st.GetStringId(s));
+    expected.append(s.c_str(), s.size() + 1);
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(i, st.GetStringId(("s" + std::to_string(i)).c_str()));
+  }
+  while (expected.size() % 4) {
+    expected.push_back(0);
+  }
+
+  OutputBuffer::PartHeader header;
+  st.PopulateHeader(&header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(st.WriteTo(&header, &output_buffer));
+  EXPECT_EQ(expected, stream.str());
+}
+
+TEST_F(BufferTest, StringTableDeltas) {
+  StringTable st;
+  StringTable::Watermark watermark;
+  int next_id = 0;
+  // Deltas end on and within blocks, and may be empty.
+  for (int count : {64, 0, 64, 3}) {
+    std::string expected;
+    for (int i = 0; i < count; i++, next_id++) {
+      std::string s = "s" + std::to_string(next_id);
+      EXPECT_EQ(next_id, st.GetStringId(s));
+      expected.append(s.c_str(), s.size() + 1);
+    }
+    size_t raw_length = watermark.raw_length + expected.size();
+    while (expected.size() % 4) {
+      expected.push_back(0);
+    }
+
+    OutputBuffer::PartHeader header;
+    st.PopulateDeltaHeader(&header, watermark);
+    EXPECT_EQ(uint32_t{StringTable::kDeltaPartType}, header.type);
+    std::stringstream stream;
+    OutputBuffer output_buffer(&stream);
+    EXPECT_TRUE(st.WriteDeltaTo(&header, &output_buffer, &watermark));
+    EXPECT_EQ(expected, stream.str());
+    EXPECT_EQ(static_cast<size_t>(next_id), watermark.count);
+    EXPECT_EQ(raw_length, watermark.raw_length);
+  }
+}
+
+TEST_F(BufferTest, StringTableStaticStrings) {
+  static const StaticString kHello{"Hello"};
+  static const StaticString kGoodbye{"Goodbye"};
+  StringTable st;
+  int id1 = st.GetStringId("Hello");
+  int id2 = st.GetStringId(kGoodbye);
+  EXPECT_EQ(id1, st.GetStringId(kHello));
+  EXPECT_EQ(id1, st.GetStringId(kHello));
+  EXPECT_EQ(id2, st.GetStringId(kGoodbye));
+  EXPECT_EQ(id2, st.GetStringId("Goodbye"));
+  EXPECT_NE(id1, id2);
+
+  // Cached ids do not survive clearing.
+  st.Clear();
+  EXPECT_EQ(0, st.GetStringId(kGoodbye));
+  EXPECT_EQ(1, st.GetStringId(kHello));
+}
+
 TEST_F(BufferTest, Serialization_StringTable0) {
   StringTable st;
   // Ordinarily, the empty string is filtered out at a higher level, but the
@@ -171,8 +306,9 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferFlushed) {
   EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
   ASSERT_EQ(0U, stream.str().size() % 4);
   auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 13);
   EXPECT_EQ((std::vector<uint32_t>{1, 2,  // Chunk header fields.
-                                   68,    // Chunk length.
+                                   80,    // Chunk length.
                                    3, 4,  // Chunk header fields.
                                    2,     // Part count.
                                    // -- String table part header.
@@ -182,10 +318,11 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferFlushed) {
                                    // -- Event buffer part header.
                                    0x20002,  // Event buffer part type.
                                    4,        // Part offset.
-                                   16,       // Part length.
+                                   28,       // Part length.
                                    // -- String table payload.
                                    0x00ee,  // String char ee + nul (LE).
-                                   // -- Event buffer payload.
+                                   // -- Event buffer payload, after a
+                                   // timebase.
                                    44, 45, 46, 47}),
             slots);
 }
@@ -229,10 +366,12 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferClearAppend) {
   EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
   ASSERT_EQ(0U, stream.str().size() % 4);
   auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 13);
+  TakeTimebase(&slots, 17);
   EXPECT_EQ((std::vector<uint32_t>{
                 1,
-                2,   // Chunk header fields.
-                76,  // Chunk length.
+                2,    // Chunk header fields.
+                100,  // Chunk length.
                 3,
                 4,  // Chunk header fields.
                 2,  // Part count.
@@ -243,10 +382,11 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferClearAppend) {
                 // -- Event buffer part header.
                 0x20002,  // Event buffer part type.
                 4,        // Part offset.
-                24,       // Part length.
+                48,       // Part length.
                 // -- String table payload.
                 0x00ee,  // String char ee + nul (LE).
-                // -- Event buffer payload.
+                // -- Event buffer payload. The prefix and the data each
+                // follow a timebase.
                 44,
                 45,
                 46,
@@ -296,10 +436,11 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferClearUnflushed) {
   EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
   ASSERT_EQ(0U, stream.str().size() % 4);
   auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 13);
   EXPECT_EQ((std::vector<uint32_t>{
                 1,
                 2,   // Chunk header fields.
-                68,  // Chunk length.
+                80,  // Chunk length.
                 3,
                 4,  // Chunk header fields.
                 2,  // Part count.
@@ -310,10 +451,10 @@ TEST_F(BufferTest, Serialization_StringTable1_EventBufferClearUnflushed) {
                 // -- Event buffer part header.
                 0x20002,  // Event buffer part type.
                 4,        // Part offset.
-                16,       // Part length.
+                28,       // Part length.
                 // -- String table payload.
                 0x00ee,  // String char ee + nul (LE).
-                // -- Event buffer payload.
+                // -- Event buffer payload, after a timebase.
                 44,
                 45,
                 46,
@@ -353,13 +494,15 @@ TEST_F(BufferTest, EventBufferExpandAndClear) {
   // Dump and clear.
   OutputBuffer::PartHeader eb_header;
   eb.PopulateHeader(&eb_header);
-  size_t expected_length = ((kChunkSlots - 2) + 8) * 4;
+  size_t expected_length = ((kChunkSlots - 2) + 8 + 6) * 4;
   EXPECT_EQ(expected_length, eb_header.length);
   std::stringstream stream;
   OutputBuffer output_buffer(&stream);
   EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
   ASSERT_EQ(0U, stream.str().size() % 4);
   auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 0);
+  TakeTimebase(&slots, 4);
 
   // Verify.
   int i = 0;
@@ -384,12 +527,14 @@ TEST_F(BufferTest, EventBufferExpandAndClear) {
   eb.Flush();
 
   eb.PopulateHeader(&eb_header);
-  EXPECT_EQ(8 * sizeof(uint32_t), eb_header.length);
+  EXPECT_EQ(14 * sizeof(uint32_t), eb_header.length);
   std::stringstream stream2;
   OutputBuffer output_buffer2(&stream2);
   EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer2, true));
   ASSERT_EQ(0U, stream2.str().size() % 4);
   slots = ExtractSlots(stream2.str());
+  TakeTimebase(&slots, 0);
+  TakeTimebase(&slots, 4);
 
   i = 0;
   EXPECT_EQ(44U, slots[i++]);
@@ -402,6 +547,611 @@ TEST_F(BufferTest, EventBufferExpandAndClear) {
   EXPECT_EQ(67U, slots[i++]);
 }
 
+TEST_F(BufferTest, EventBufferRecyclesClearedChunks) {
+  const uint32_t kChunkSlots = 256;
+  EventBuffer eb(kChunkSlots * sizeof(uint32_t));
+
+  // Fill the first chunk and overflow into a second.
+  uint32_t* first_chunk_slots = eb.AddSlots(kChunkSlots);
+  eb.Flush();
+  uint32_t* second_chunk_slots = eb.AddSlots(4);
+  eb.Flush();
+  EXPECT_NE(first_chunk_slots, second_chunk_slots);
+
+  // Clearing releases the first chunk, which the next overflow should pick
+  // up instead of allocating.
+  ASSERT_TRUE(DummyWriteAndClearEventBuffer(&eb));
+  eb.AddSlots(kChunkSlots - 4);
+  eb.Flush();
+  uint32_t* third_chunk_slots = eb.AddSlots(4);
+  third_chunk_slots[0] = 1;
+  third_chunk_slots[1] = 2;
+  third_chunk_slots[2] = 3;
+  third_chunk_slots[3] = 4;
+  eb.Flush();
+  EXPECT_EQ(first_chunk_slots, third_chunk_slots);
+
+  // The recycled chunk must start out empty.
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 0);
+  ASSERT_EQ(kChunkSlots - 4 + 4, slots.size());
+  EXPECT_EQ((std::vector<uint32_t>{1, 2, 3, 4}),
+            std::vector<uint32_t>(slots.end() - 4, slots.end()));
+}
+
+TEST_F(BufferTest, EventBufferReserveChunks) {
+  const uint32_t kChunkSlots = 256;
+  EventBuffer eb(kChunkSlots * sizeof(uint32_t));
+  eb.ReserveChunks(2);
+
+  // Overflowing twice consumes the reserved chunks.
+  eb.AddSlots(kChunkSlots);
+  uint32_t* slots = eb.AddSlots(kChunkSlots);
+  slots[kChunkSlots - 1] = 42;
+  slots = eb.AddSlots(1);
+  slots[0] = 43;
+  eb.Flush();
+
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  EXPECT_EQ((3 + 2 * kChunkSlots + 1) * sizeof(uint32_t), eb_header.length);
+}
+
+TEST_F(BufferTest, EventBufferFlightRecorderOverwritesOldest) {
+  const uint32_t kChunkSlots = 256;
+  const uint32_t kEventsPerChunk = kChunkSlots / 2;
+  EventBuffer eb(kChunkSlots * sizeof(uint32_t));
+  eb.SetMaximumChunkCount(3);
+
+  // Write five chunks worth of two slot events, timestamped by index.
+  for (uint32_t i = 0; i < 5 * kEventsPerChunk; i++) {
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = 100;
+    slots[1] = i;
+  }
+  eb.Flush();
+  EXPECT_EQ(2u, eb.discarded_chunk_count());
+
+  // Only the last three chunks remain, preceded by a discontinuity stamped
+  // with the time of the oldest retained event.
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto slots = ExtractSlots(stream.str());
+  uint64_t discontinuity_time = TakeTimebase(&slots, 0);
+  TakeTimebase(&slots, 2);
+  ASSERT_EQ(2 + 3 * kChunkSlots, slots.size());
+  EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kDiscontinuityEventId),
+            slots[0]);
+  EXPECT_EQ(2 * kEventsPerChunk, slots[1]);
+  EXPECT_EQ(2 * kEventsPerChunk, static_cast<uint32_t>(discontinuity_time));
+  EXPECT_EQ(100u, slots[2]);
+  EXPECT_EQ(2 * kEventsPerChunk, slots[3]);
+  EXPECT_EQ(5 * kEventsPerChunk - 1, slots.back());
+
+  // Once cleared, subsequent data is contiguous again.
+  uint32_t* new_slots = eb.AddSlots(2);
+  new_slots[0] = 100;
+  new_slots[1] = 42;
+  eb.Flush();
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream2;
+  OutputBuffer output_buffer2(&stream2);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer2, true));
+  slots = ExtractSlots(stream2.str());
+  TakeTimebase(&slots, 0);
+  EXPECT_EQ((std::vector<uint32_t>{100, 42}), slots);
+}
+
+TEST_F(BufferTest, EventBufferPopulateHeaderMaxAge) {
+  const uint32_t kChunkSlots = 256;
+  const uint32_t kMaxAgeMicros = 100000;
+  EventBuffer eb(kChunkSlots * sizeof(uint32_t));
+
+  // Two chunks of old events followed by a chunk of current ones. Each
+  // chunk starts with a timebase, followed by a single event filling it.
+  uint64_t old_time = PlatformGetTimestampNanos64();
+  for (uint32_t i = 0; i < 3; i++) {
+    if (i == 2) {
+      usleep(2 * kMaxAgeMicros);
+    }
+    uint64_t time = i < 2 ? old_time : PlatformGetTimestampNanos64();
+    uint32_t* slots = eb.AddSlots(3);
+    slots[0] = StandardEvents::kTimebaseEventId;
+    slots[1] = static_cast<uint32_t>(time);
+    slots[2] = static_cast<uint32_t>(time >> 32);
+    slots = eb.AddSlots(kChunkSlots - 3);
+    slots[0] = i;
+    slots[1] = static_cast<uint32_t>(time);
+  }
+  eb.Flush();
+
+  // The first chunk is dropped. The second is kept, since it runs up to the
+  // cutoff as far as the buffer can tell.
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header, kMaxAgeMicros);
+  EXPECT_EQ(old_time, eb.snapshot_start_time_nanos());
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto slots = ExtractSlots(stream.str());
+  EXPECT_EQ(old_time, TakeTimebase(&slots, 0));
+  TakeTimebase(&slots, 2);
+  ASSERT_EQ(2 + 2 * kChunkSlots, slots.size());
+  EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kDiscontinuityEventId),
+            slots[0]);
+  EXPECT_EQ(static_cast<uint32_t>(old_time), slots[1]);
+  EXPECT_EQ(old_time, TakeTimebase(&slots, 2));
+  EXPECT_EQ(1u, slots[2]);
+  EXPECT_EQ(0u, eb.discarded_chunk_count());
+
+  // Everything was cleared, including the skipped chunk.
+  eb.PopulateHeader(&eb_header, kMaxAgeMicros);
+  EXPECT_EQ(0u, eb_header.length);
+}
+
+TEST_F(BufferTest, EventBufferMemoryBudgetDropsEvents) {
+  const uint32_t kChunkSlots = 256;
+  const uint32_t kEventsPerChunk = kChunkSlots / 2;
+  const size_t kChunkBytes = kChunkSlots * sizeof(uint32_t);
+  MemoryBudget budget;
+  budget.set_limit_bytes(2 * kChunkBytes);
+  EventBuffer eb(kChunkBytes);
+  eb.SetMemoryBudget(&budget);
+  EXPECT_EQ(kChunkBytes, budget.used_bytes());
+
+  // Two chunks fit in the budget. Events beyond that are dropped.
+  for (uint32_t i = 0; i < 2 * kEventsPerChunk + 10; i++) {
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = 100;
+    slots[1] = i;
+  }
+  eb.Flush();
+  EXPECT_EQ(2 * kChunkBytes, budget.used_bytes());
+  EXPECT_EQ(10u, eb.dropped_event_count());
+
+  // The count trails the retained data.
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto slots = ExtractSlots(stream.str());
+  TakeTimebase(&slots, 0);
+  TakeTimebase(&slots, 2 * kChunkSlots);
+  ASSERT_EQ(2 * kChunkSlots + 3, slots.size());
+  EXPECT_EQ(2 * kEventsPerChunk - 1, slots[2 * kChunkSlots - 1]);
+  EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kDroppedEventsEventId),
+            slots[2 * kChunkSlots]);
+  EXPECT_EQ(10u, slots.back());
+
+  // Clearing under budget pressure returns the released chunk to the heap,
+  // and logging resumes without reporting the same drops again.
+  EXPECT_EQ(kChunkBytes, budget.used_bytes());
+  uint32_t* new_slots = eb.AddSlots(2);
+  new_slots[0] = 100;
+  new_slots[1] = 42;
+  eb.Flush();
+  EXPECT_EQ(10u, eb.dropped_event_count());
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream2;
+  OutputBuffer output_buffer2(&stream2);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer2, true));
+  slots = ExtractSlots(stream2.str());
+  TakeTimebase(&slots, 0);
+  EXPECT_EQ((std::vector<uint32_t>{100, 42}), slots);
+}
+
+TEST_F(BufferTest, EventBufferChunkPool) {
+  const uint32_t kChunkSlots = 256;
+  const size_t kChunkBytes = kChunkSlots * sizeof(uint32_t);
+  MemoryBudget budget;
+  budget.set_limit_bytes(3 * kChunkBytes);
+  EventBuffer::ChunkPool pool{2, &budget};
+  {
+    EventBuffer eb(kChunkBytes, &pool);
+    eb.ReserveChunks(2);
+    EXPECT_EQ(3 * kChunkBytes, budget.used_bytes());
+  }
+  // At most two chunks are kept, and stay charged to the budget.
+  EXPECT_EQ(2u, pool.chunk_count());
+  EXPECT_EQ(2 * kChunkBytes, budget.used_bytes());
+
+  // A new buffer starts in a pooled chunk and expands into the other.
+  EventBuffer eb(kChunkBytes, &pool);
+  EXPECT_EQ(1u, pool.chunk_count());
+  for (uint32_t i = 0; i < kChunkSlots / 2 + 1; i++) {
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = 100;
+    slots[1] = i;
+  }
+  eb.Flush();
+  EXPECT_EQ(0u, pool.chunk_count());
+  EXPECT_EQ(2 * kChunkBytes, budget.used_bytes());
+  EXPECT_EQ(0u, eb.dropped_event_count());
+
+  // Pooled chunks go back to the heap once the budget is exceeded.
+  eb.ReserveChunks(1);
+  budget.set_limit_bytes(kChunkBytes);
+  EventBuffer::ChunkPool small_pool{2, &budget};
+  {
+    EventBuffer other(kChunkBytes, &small_pool);
+  }
+  EXPECT_EQ(0u, small_pool.chunk_count());
+  EXPECT_EQ(3 * kChunkBytes, budget.used_bytes());
+}
+
+TEST_F(BufferTest, ResourceTableReleasesWrittenResources) {
+  const size_t kChunkBytes = EventBuffer::kMinimumChunkSizeBytes;
+  const std::string kPayload(100, 'r');
+  MemoryBudget budget;
+  EventBuffer eb(kChunkBytes);
+  eb.SetMemoryBudget(&budget);
+  ResourceTable* resource_table = eb.resource_table();
+  auto add_event = [&]() {
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = 100;
+    slots[1] = resource_table->AddResource(kPayload.data(), kPayload.size());
+  };
+  for (int i = 0; i < 20; i++) {
+    add_event();
+    eb.Flush();
+  }
+  // This event is not published by the time of the save.
+  add_event();
+  EXPECT_EQ(kChunkBytes + 21 * kPayload.size(), budget.used_bytes());
+
+  // A clearing save writes every resource, then frees those whose events it
+  // cleared.
+  OutputBuffer::PartHeader eb_header;
+  std::vector<OutputBuffer::PartHeader> resource_headers;
+  eb.PopulateHeader(&eb_header);
+  resource_table->PopulateHeaders(&resource_headers);
+  ASSERT_EQ(21u, resource_headers.size());
+  EXPECT_EQ(uint32_t{ResourceTable::kPartType}, resource_headers[0].type);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, nullptr, true));
+  EXPECT_TRUE(resource_table->WriteTo(resource_headers, nullptr));
+  EXPECT_EQ(kChunkBytes + kPayload.size(), budget.used_bytes());
+
+  // Later saves start at the first resource that is left, after a part
+  // holding its id.
+  eb.Flush();
+  resource_headers.clear();
+  resource_table->PopulateHeaders(&resource_headers);
+  ASSERT_EQ(2u, resource_headers.size());
+  EXPECT_EQ(uint32_t{ResourceTable::kBasePartType},
+            resource_headers[0].type);
+  EXPECT_EQ(4u, resource_headers[0].length);
+  EXPECT_EQ(kPayload.size(), resource_headers[1].length);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(resource_table->WriteTo(resource_headers, &output_buffer));
+  std::string written = stream.str();
+  ASSERT_EQ(4 + kPayload.size(), written.size());
+  EXPECT_EQ(20u, ExtractSlots(written.substr(0, 4))[0]);
+  EXPECT_EQ(kPayload, written.substr(4));
+
+  // Payloads that do not fit in the budget are not stored.
+  budget.set_limit_bytes(budget.used_bytes());
+  EXPECT_EQ(uint32_t{ResourceTable::kDroppedResourceId},
+            resource_table->AddResource(kPayload.data(), kPayload.size()));
+  budget.set_limit_bytes(0);
+  EXPECT_EQ(21u,
+            resource_table->AddResource(kPayload.data(), kPayload.size()));
+}
+
+TEST_F(BufferTest, EventBufferTimebaseAfterDroppedEvents) {
+  const uint32_t kChunkSlots = 256;
+  const size_t kChunkBytes = kChunkSlots * sizeof(uint32_t);
+  MemoryBudget budget;
+  budget.set_limit_bytes(kChunkBytes);
+  EventBuffer eb(kChunkBytes);
+  eb.SetMemoryBudget(&budget);
+
+  // Fill the only chunk and drop an event, then raise the limit so that the
+  // next one lands in a new chunk.
+  eb.AddSlots(kChunkSlots);
+  eb.AddSlots(2);
+  EXPECT_EQ(1u, eb.dropped_event_count());
+  budget.set_limit_bytes(2 * kChunkBytes);
+  uint32_t* slots = eb.AddSlots(2);
+  slots[0] = 100;
+  slots[1] = 42;
+  eb.Flush();
+
+  // The new chunk does not follow on from the old one, so it gets a
+  // timebase of its own.
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto written_slots = ExtractSlots(stream.str());
+  TakeTimebase(&written_slots, 0);
+  TakeTimebase(&written_slots, kChunkSlots);
+  TakeTimebase(&written_slots, kChunkSlots + 2);
+  ASSERT_EQ(kChunkSlots + 2 + 3, written_slots.size());
+  EXPECT_EQ(100u, written_slots[kChunkSlots]);
+  EXPECT_EQ(42u, written_slots[kChunkSlots + 1]);
+}
+
+TEST_F(BufferTest, EventBufferEventTimesUnwrap) {
+  EventBuffer eb;
+  uint64_t start_time = PlatformGetTimestampNanos64();
+  auto add_event = [&eb](uint32_t id) {
+    uint32_t time = eb.GetEventTime();
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = id;
+    slots[1] = time;
+    eb.Flush();
+  };
+
+  // An idle period longer than the timebase interval adds a timebase.
+  add_event(100);
+  usleep(EventBuffer::kTimebaseIntervalNanos / 1000 + 10000);
+  add_event(101);
+  uint64_t end_time = PlatformGetTimestampNanos64();
+
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+  auto slots = ExtractSlots(stream.str());
+  uint64_t base_time = TakeTimebase(&slots, 0);
+  uint64_t idle_time = TakeTimebase(&slots, 2);
+  ASSERT_EQ(4u, slots.size());
+  EXPECT_EQ(100u, slots[0]);
+  EXPECT_EQ(101u, slots[2]);
+
+  // Reconstruct the full times the way that a reader would.
+  uint64_t first_time =
+      base_time + static_cast<uint32_t>(slots[1] -
+                                        static_cast<uint32_t>(base_time));
+  EXPECT_LE(start_time, first_time);
+  EXPECT_EQ(static_cast<uint32_t>(idle_time), slots[3]);
+  EXPECT_LE(first_time + EventBuffer::kTimebaseIntervalNanos, idle_time);
+  EXPECT_GE(end_time, idle_time);
+}
+
+TEST_F(BufferTest, EventBufferCompactEncoding) {
+  EventBuffer eb;
+  eb.SetCompactEncoding(true);
+  EventEnabled<uint32_t, uint16_t> event("BufferTest#compact: a, b");
+  ScopedEventEnabled<> scope("BufferTest#compactScope");
+  uint64_t start_time = PlatformGetTimestampNanos64();
+  for (uint32_t i = 0; i < 100; i++) {
+    scope.EnterSpecific(&eb);
+    event.InvokeSpecific(&eb, i, 7);
+    scope.LeaveSpecific(&eb);
+  }
+  eb.AddCompactEvent(100, nullptr, 0);
+  std::vector<uint32_t> many_args(20);
+  for (uint32_t i = 0; i < many_args.size(); i++) {
+    many_args[i] = i << 20;
+  }
+  eb.AddCompactEvent(101, many_args.data(), many_args.size());
+  eb.Flush();
+  uint64_t end_time = PlatformGetTimestampNanos64();
+
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  EXPECT_EQ(0x20003u, eb_header.type);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
+  std::string written = stream.str();
+  ASSERT_EQ((eb_header.length + 3) / 4 * 4, written.size());
+
+  // Each iteration takes 8 slots (32 bytes) in the slot encoding.
+  EXPECT_GT(100u * 32 / 2, eb_header.length);
+
+  auto events = DecodeCompactEvents(written.substr(0, eb_header.length));
+  ASSERT_EQ(1u + 300 + 2, events.size());
+  EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kTimebaseEventId),
+            events[0].wire_id);
+  uint64_t last_time = start_time;
+  for (uint32_t i = 0; i < 100; i++) {
+    const CompactEvent* iteration = &events[1 + 3 * i];
+    EXPECT_EQ(static_cast<uint32_t>(scope.wire_id()), iteration[0].wire_id);
+    EXPECT_TRUE(iteration[0].args.empty());
+    EXPECT_EQ(static_cast<uint32_t>(event.wire_id()), iteration[1].wire_id);
+    EXPECT_EQ((std::vector<uint32_t>{i, 7}), iteration[1].args);
+    EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kScopeLeaveEventId),
+              iteration[2].wire_id);
+    for (int j = 0; j < 3; j++) {
+      EXPECT_LE(last_time, iteration[j].time);
+      last_time = iteration[j].time;
+    }
+  }
+  EXPECT_EQ(100u, events[301].wire_id);
+  EXPECT_EQ(101u, events[302].wire_id);
+  EXPECT_EQ(many_args, events[302].args);
+  EXPECT_GE(end_time, events[302].time);
+}
+
+TEST_F(BufferTest, EventBufferRewindUnpublished) {
+  EventBuffer eb;
+  eb.SetCompactEncoding(true);
+  EventEnabled<uint32_t> event("BufferTest#rewind: a");
+  event.InvokeSpecific(&eb, 1);
+
+  // Unpublished events can be taken back, restoring the time that the next
+  // event's delta is relative to.
+  EventBuffer::Mark mark = eb.GetMark();
+  event.AddSpecific(&eb, 2);
+  event.AddSpecific(&eb, 3);
+  EXPECT_TRUE(eb.RewindTo(mark));
+  uint64_t rewound_time = PlatformGetTimestampNanos64();
+  event.InvokeSpecific(&eb, 4);
+
+  // Published ones cannot.
+  mark = eb.GetMark();
+  event.InvokeSpecific(&eb, 5);
+  EXPECT_FALSE(eb.RewindTo(mark));
+  uint64_t end_time = PlatformGetTimestampNanos64();
+
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
+  auto events = DecodeCompactEvents(stream.str().substr(0, eb_header.length));
+  ASSERT_EQ(1u + 3, events.size());
+  uint64_t last_time = 0;
+  for (size_t i = 1; i < events.size(); i++) {
+    EXPECT_EQ(static_cast<uint32_t>(event.wire_id()), events[i].wire_id);
+    EXPECT_LE(last_time, events[i].time);
+    last_time = events[i].time;
+  }
+  EXPECT_EQ((std::vector<uint32_t>{1}), events[1].args);
+  EXPECT_EQ((std::vector<uint32_t>{4}), events[2].args);
+  EXPECT_LE(rewound_time, events[2].time);
+  EXPECT_EQ((std::vector<uint32_t>{5}), events[3].args);
+  EXPECT_GE(end_time, events[3].time);
+}
+
+TEST_F(BufferTest, EventBufferRewindAfterChunkReuse) {
+  const uint32_t kChunkSlots = 256;
+  ScopedEventEnabled<> scope("BufferTest#reuseScope", EventCategories::kDefault,
+                             1000000000);
+  for (bool flight_recorder : {true, false}) {
+    EventBuffer eb(kChunkSlots * sizeof(uint32_t));
+    if (flight_recorder) {
+      eb.SetMaximumChunkCount(2);
+    }
+
+    // Enter a collapsible scope part way through the first chunk.
+    uint32_t* first_slots = eb.AddSlots(200);
+    for (uint32_t i = 0; i < 200; i += 2) {
+      first_slots[i] = 100;
+      first_slots[i + 1] = i;
+    }
+    eb.Flush();
+    EventBuffer::Mark mark = scope.EnterCollapsibleSpecific(&eb);
+
+    // Publish events until the first chunk is overwritten (flight recorder)
+    // or recycled by a clearing save and becomes current again.
+    eb.AddSlots(kChunkSlots - 202);
+    eb.Flush();
+    eb.AddSlots(2);
+    eb.Flush();
+    if (!flight_recorder) {
+      ASSERT_TRUE(DummyWriteAndClearEventBuffer(&eb));
+    }
+    eb.AddSlots(kChunkSlots - 2);
+    eb.Flush();
+    uint32_t* slots = eb.AddSlots(2);
+    slots[0] = 101;
+    slots[1] = 0;
+    eb.Flush();
+    ASSERT_EQ(first_slots, slots);
+
+    // The scope is kept, not collapsed over the chunk's stale slots.
+    scope.LeaveCollapsibleSpecific(&eb, mark);
+    EXPECT_EQ(0u, eb.throttle_state(scope.wire_id())->skipped_count);
+    eb.Flush();
+    OutputBuffer::PartHeader eb_header;
+    eb.PopulateHeader(&eb_header);
+    std::stringstream stream;
+    OutputBuffer output_buffer(&stream);
+    EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
+    auto out_slots = ExtractSlots(stream.str());
+    ASSERT_LE(4u, out_slots.size());
+    EXPECT_EQ(101u, out_slots[out_slots.size() - 4]);
+    EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kScopeLeaveEventId),
+              out_slots[out_slots.size() - 2]);
+  }
+}
+
+TEST_F(BufferTest, EventBufferCompactDropKeepsDeltaBase) {
+  MemoryBudget budget;
+  budget.set_limit_bytes(EventBuffer::kMinimumChunkSizeBytes);
+  EventBuffer eb(EventBuffer::kMinimumChunkSizeBytes);
+  eb.SetMemoryBudget(&budget);
+  eb.SetCompactEncoding(true);
+
+  // Large events (zero args encode in far less than their worst case) until
+  // one no longer fits and cannot get a new chunk. Small events still fit.
+  std::vector<uint32_t> large_args(100);
+  while (!eb.dropped_event_count()) {
+    usleep(10000);
+    eb.AddCompactEvent(101, large_args.data(), large_args.size());
+  }
+
+  // The next delta is relative to the last written event, not the dropped
+  // one, so the small event decodes no earlier than it was logged.
+  uint64_t small_time = PlatformGetTimestampNanos64();
+  eb.AddCompactEvent(100, nullptr, 0);
+  eb.Flush();
+  EXPECT_EQ(1u, eb.dropped_event_count());
+
+  OutputBuffer::PartHeader eb_header;
+  eb.PopulateHeader(&eb_header);
+  std::stringstream stream;
+  OutputBuffer output_buffer(&stream);
+  EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, false));
+  auto events = DecodeCompactEvents(stream.str().substr(0, eb_header.length));
+  // The dropped events marker trails the retained data.
+  ASSERT_LT(3u, events.size());
+  const CompactEvent& large = events[events.size() - 4];
+  const CompactEvent& small = events[events.size() - 3];
+  EXPECT_EQ(101u, large.wire_id);
+  EXPECT_EQ(100u, small.wire_id);
+  EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kDroppedEventsEventId),
+            events.back().wire_id);
+  EXPECT_LE(small_time, small.time);
+}
+
+TEST_F(BufferTest, EventBufferCompactClearAcrossChunks) {
+  EventBuffer eb(EventBuffer::kMinimumChunkSizeBytes);
+  eb.SetCompactEncoding(true);
+  uint32_t next_arg = 0;
+  auto add_events = [&eb, &next_arg](size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      uint32_t arg = next_arg++;
+      eb.AddCompactEvent(100, &arg, 1);
+      eb.Flush();
+    }
+  };
+
+  // Spans several chunks, each of which gets a timebase of its own, and
+  // ends partway through one so that the next write resumes mid chunk.
+  uint32_t expected_arg = 0;
+  uint64_t last_time = 0;
+  for (int round = 0; round < 3; round++) {
+    add_events(round == 1 ? 10 : 1000);
+    OutputBuffer::PartHeader eb_header;
+    eb.PopulateHeader(&eb_header);
+    std::stringstream stream;
+    OutputBuffer output_buffer(&stream);
+    EXPECT_TRUE(eb.WriteTo(&eb_header, &output_buffer, true));
+    auto events =
+        DecodeCompactEvents(stream.str().substr(0, eb_header.length));
+    ASSERT_FALSE(events.empty());
+    EXPECT_EQ(static_cast<uint32_t>(StandardEvents::kTimebaseEventId),
+              events[0].wire_id);
+    for (auto& event : events) {
+      EXPECT_LE(last_time, event.time);
+      last_time = event.time;
+      if (event.wire_id == StandardEvents::kTimebaseEventId) {
+        continue;
+      }
+      EXPECT_EQ(100u, event.wire_id);
+      ASSERT_EQ(1u, event.args.size());
+      EXPECT_EQ(expected_arg++, event.args[0]);
+    }
+  }
+  EXPECT_EQ(next_arg, expected_arg);
+}
+
 }  // namespace
 }  // namespace wtf
 
@@ -8,7 +8,9 @@
 namespace wtf {
 
 platform::atomic<int> EventDefinition::next_event_id_{
-    StandardEvents::kScopeLeaveEventId + 1};
+    StandardEvents::kTimebaseEventId + 1};
+
+platform::atomic<uint32_t> EventCategories::enabled_{EventCategories::kAll};
 
 namespace {
 bool IsSepCharOrNull(char c) {
@@ -154,26 +156,50 @@ ZoneRegistry* ZoneRegistry::GetInstance() {
 int ZoneRegistry::CreateZone(const char* name, const char* type,
                              const char* location) {
   platform::lock_guard<platform::mutex> lock{mu_};
-  int id = next_zone_id_.fetch_add(1);
-  zone_definitions_.push_back(ZoneDefinition{
-      id, name ? name : "", type ? type : "", location ? location : ""});
+  int id;
+  if (!released_zone_ids_.empty()) {
+    id = released_zone_ids_.back();
+    released_zone_ids_.pop_back();
+  } else {
+    zone_definitions_.emplace_back();
+    id = static_cast<int>(zone_definitions_.size());
+  }
+  auto& definition = zone_definitions_[id - 1];
+  definition.name = name ? name : "";
+  definition.type = type ? type : "";
+  definition.location = location ? location : "";
+  definition.sequence = next_sequence_++;
+  definition.released = false;
   return id;
 }
 
-int ZoneRegistry::EmitZones(EventBuffer* event_buffer, size_t from_index) {
+void ZoneRegistry::ReleaseZone(int zone_id) {
   platform::lock_guard<platform::mutex> lock{mu_};
-  size_t size = zone_definitions_.size();
-  if (from_index >= size) {
-    return size;
+  if (zone_id < 1 || static_cast<size_t>(zone_id) > zone_definitions_.size() ||
+      zone_definitions_[zone_id - 1].released) {
+    return;
   }
-  for (size_t i = from_index; i < size; i++) {
+  auto& definition = zone_definitions_[zone_id - 1];
+  definition.released = true;
+  definition.name.clear();
+  definition.type.clear();
+  definition.location.clear();
+  released_zone_ids_.push_back(zone_id);
+}
+
+size_t ZoneRegistry::EmitZones(EventBuffer* event_buffer,
+                               size_t from_sequence) {
+  platform::lock_guard<platform::mutex> lock{mu_};
+  for (size_t i = 0; i < zone_definitions_.size(); i++) {
     auto& definition = zone_definitions_[i];
-    StandardEvents::CreateZone(event_buffer, definition.id,
+    if (definition.released || definition.sequence < from_sequence) {
+      continue;
+    }
+    StandardEvents::CreateZone(event_buffer, static_cast<int>(i + 1),
                                definition.name.c_str(), definition.type.c_str(),
                                definition.location.c_str());
   }
-
-  return size;
+  return next_sequence_;
 }
 
 StandardEvents::ScopeLeaveEventType& StandardEvents::GetScopeLeaveEvent() {
@@ -183,6 +209,39 @@ StandardEvents::ScopeLeaveEventType& StandardEvents::GetScopeLeaveEvent() {
   return event;
 }
 
+StandardEvents::DiscontinuityEventType&
+StandardEvents::GetDiscontinuityEvent() {
+  static DiscontinuityEventType event{kDiscontinuityEventId,
+                                      EventClass::kInstance,
+                                      EventFlags::kBuiltin,
+                                      "wtf.trace#discontinuity"};
+  return event;
+}
+
+StandardEvents::DroppedEventsEventType&
+StandardEvents::GetDroppedEventsEvent() {
+  static DroppedEventsEventType event{kDroppedEventsEventId,
+                                      EventClass::kInstance,
+                                      EventFlags::kBuiltin,
+                                      "wtf.trace#dropped: count"};
+  return event;
+}
+
+StandardEvents::TimebaseEventType& StandardEvents::GetTimebaseEvent() {
+  static TimebaseEventType event{kTimebaseEventId, EventClass::kInstance,
+                                 EventFlags::kBuiltin | EventFlags::kInternal,
+                                 "wtf.trace#timebase: high"};
+  return event;
+}
+
+void StandardEvents::Skipped(EventBuffer* event_buffer, uint32_t wire_id,
+                             uint32_t count) {
+  static EventEnabled<uint32_t, uint32_t> event{
+      EventClass::kInstance, EventFlags::kInternal,
+      "wtf.trace#skipped: wireId, count"};
+  event.InvokeSpecific(event_buffer, wire_id, count);
+}
+
 StandardEvents::CreateZoneEventType& StandardEvents::GetCreateZoneEvent() {
   static CreateZoneEventType event{EventClass::kInstance,
                                    EventFlags::kBuiltin | EventFlags::kInternal,
@@ -193,7 +252,9 @@ StandardEvents::CreateZoneEventType& StandardEvents::GetCreateZoneEvent() {
 void StandardEvents::DefineEvent(EventBuffer* event_buffer, uint16_t wire_id,
                                  uint16_t event_class, uint32_t flags,
                                  const char* name, const char* args) {
-  static EventEnabled<uint16_t, uint16_t, uint32_t, const char*, const char*>
+  // The reader has a built in definition of this event, so its arguments
+  // must not be packed.
+  static EventEnabled<uint32_t, uint32_t, uint32_t, const char*, const char*>
       event{1, EventClass::kInstance,
             EventFlags::kBuiltin | EventFlags::kInternal,
             "wtf.event#define:wireId,eventClass,flags,name,args"};
@@ -0,0 +1,217 @@
+// Microbenchmarks for the per-event hot path.
+//
+// Each benchmark runs a tight loop against the current thread's EventBuffer
+// and reports the best of several repetitions as nanoseconds and bytes of
+// EventBuffer data per operation. An operation is a single invocation for
+// instance events and a balanced enter/leave pair for scopes.
+//
+// Usage:
+//   ./event_bench [iterations]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "wtf/macros.h"
+
+namespace {
+
+constexpr size_t kDefaultIterations = 1000000;
+constexpr int kRepetitions = 5;
+
+volatile uint32_t sink;
+
+size_t PublishedBytes(wtf::EventBuffer* event_buffer) {
+  if (!event_buffer) {
+    return 0;
+  }
+  wtf::OutputBuffer::PartHeader header;
+  event_buffer->PopulateHeader(&header);
+  return header.length;
+}
+
+// Runs fn() 'iterations' times for each repetition, clearing thread data in
+// between so that memory use stays bounded, and prints the fastest run.
+template <typename Fn>
+void RunBenchmark(const char* name, size_t iterations, Fn fn) {
+  double best_ns = 0;
+  double bytes_per_op = 0;
+  for (int rep = 0; rep < kRepetitions; rep++) {
+    wtf::Runtime::GetInstance()->ClearThreadData();
+    wtf::EventBuffer* event_buffer = wtf::PlatformGetThreadLocalEventBuffer();
+    size_t start_bytes = PublishedBytes(event_buffer);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+      fn(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    size_t end_bytes = PublishedBytes(event_buffer);
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+                iterations;
+    if (rep == 0 || ns < best_ns) {
+      best_ns = ns;
+    }
+    bytes_per_op = static_cast<double>(end_bytes - start_bytes) / iterations;
+  }
+  std::printf("%-40s %10.2f ns/op %8.2f bytes/op\n", name, best_ns,
+              bytes_per_op);
+}
+
+void AutoFunction() { WTF_AUTO_FUNCTION(); }
+
+// Keeps the compiler from hoisting the thread local lookup out of a loop
+// when nothing in the loop body can change it.
+inline void ClobberMemory() { asm volatile("" : : : "memory"); }
+
+}  // namespace
+
+extern "C" int main(int argc, char** argv) {
+  size_t iterations = kDefaultIterations;
+  if (argc > 1) {
+    iterations = std::strtoul(argv[1], nullptr, 10);
+    if (iterations == 0) {
+      std::fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  auto runtime = wtf::Runtime::GetInstance();
+  runtime->EnableCurrentThread("EventBench");
+  std::printf("Running %zu iterations x %d repetitions.\n", iterations,
+              kRepetitions);
+
+  RunBenchmark("PlatformGetTimestampNanos64", iterations, [](size_t) {
+    sink = static_cast<uint32_t>(wtf::PlatformGetTimestampNanos64());
+  });
+
+  wtf::EventBuffer* event_buffer = wtf::PlatformGetThreadLocalEventBuffer();
+  RunBenchmark("EventBuffer::GetEventTime", iterations,
+               [event_buffer](size_t) { sink = event_buffer->GetEventTime(); });
+  RunBenchmark("EventBuffer::AddSlots(2)+Flush", iterations,
+               [event_buffer](size_t i) {
+                 uint32_t* slots = event_buffer->AddSlots(2);
+                 slots[0] = 0;
+                 slots[1] = i;
+                 event_buffer->Flush();
+               });
+
+  wtf::EventEnabled<> event0{"EventBench#Event0"};
+  RunBenchmark("EventIf::Invoke()", iterations,
+               [&event0](size_t) { event0.Invoke(); });
+
+  wtf::EventEnabled<int32_t, int32_t> event2{"EventBench#Event2: a, b"};
+  RunBenchmark("EventIf::Invoke(int32, int32)", iterations,
+               [&event2](size_t i) { event2.Invoke(i, 1); });
+
+  wtf::EventEnabled<bool, uint8_t, uint16_t> event_packed{
+      "EventBench#EventPacked: a, b, c"};
+  RunBenchmark("EventIf::Invoke(bool, uint8, uint16)", iterations,
+               [&event_packed](size_t i) {
+                 event_packed.Invoke(i & 1, static_cast<uint8_t>(i),
+                                     static_cast<uint16_t>(i));
+               });
+
+  wtf::EventEnabled<wtf::Array<uint32_t>> event_array{
+      "EventBench#EventArray: a"};
+  const uint32_t array_values[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  RunBenchmark("EventIf::Invoke(uint32[8])", iterations,
+               [&event_array, &array_values](size_t) {
+                 event_array.Invoke(wtf::Array<uint32_t>{array_values, 8});
+               });
+
+  wtf::EventEnabled<const char*> event_cstr{"EventBench#EventCStr: s"};
+  RunBenchmark("EventIf::Invoke(const char*)", iterations,
+               [&event_cstr](size_t) { event_cstr.Invoke("some_string"); });
+
+  wtf::EventEnabled<const std::string> event_str{"EventBench#EventStr: s"};
+  const std::string str_value{"some_std_string"};
+  RunBenchmark("EventIf::Invoke(std::string)", iterations,
+               [&event_str, &str_value](size_t) {
+                 event_str.Invoke(str_value);
+               });
+
+  wtf::EventEnabled<wtf::InlineString> event_inline{
+      "EventBench#EventInline: s"};
+  RunBenchmark("EventIf::Invoke(InlineString)", iterations,
+               [&event_inline, &str_value](size_t) {
+                 event_inline.Invoke(wtf::InlineString{str_value});
+               });
+
+  wtf::EventEnabled<wtf::StaticString> event_static{
+      "EventBench#EventStatic: s"};
+  RunBenchmark("EventIf::Invoke(StaticString)", iterations,
+               [&event_static](size_t) {
+                 event_static.Invoke(WTF_STATIC_STRING("some_string"));
+               });
+
+  wtf::ScopedEventEnabled<> scoped0{"EventBench#Scoped0"};
+  RunBenchmark("ScopedEventIf::EnterSpecific/Leave", iterations,
+               [&scoped0, event_buffer](size_t) {
+                 scoped0.EnterSpecific(event_buffer);
+                 scoped0.LeaveSpecific(event_buffer);
+               });
+
+  wtf::ScopedEventEnabled<int32_t> scoped1{"EventBench#Scoped1: i"};
+  RunBenchmark("AutoScopeIf(int32)", iterations, [&scoped1](size_t i) {
+    wtf::AutoScopeEnabled<int32_t> scope{scoped1};
+    scope.Enter(i);
+  });
+
+  RunBenchmark("WTF_AUTO_FUNCTION", iterations,
+               [](size_t) { AutoFunction(); });
+
+  // Compact encoding, on a thread buffer of its own.
+  runtime->SetCompactEncoding(true);
+  wtf::EventBuffer* compact_buffer =
+      runtime->RegisterExternalThread("EventBenchCompact");
+  runtime->SetCompactEncoding(false);
+  wtf::PlatformSetThreadLocalEventBuffer(compact_buffer);
+  RunBenchmark("EventIf::Invoke(int32, int32) [compact]", iterations,
+               [&event2](size_t i) { event2.Invoke(i & 0xff, 1); });
+  RunBenchmark("AutoScopeIf(int32) [compact]", iterations,
+               [&scoped1](size_t i) {
+                 wtf::AutoScopeEnabled<int32_t> scope{scoped1};
+                 scope.Enter(i & 0xff);
+               });
+  wtf::PlatformSetThreadLocalEventBuffer(event_buffer);
+
+  // Throttled sites, where most invocations are skipped.
+  RunBenchmark("WTF_SAMPLED_EVENT(1 in 100, int32)", iterations, [](size_t i) {
+    WTF_SAMPLED_EVENT(100, "EventBench#Sampled: i", int32_t)(i);
+  });
+  RunBenchmark("WTF_RATE_LIMITED_SCOPE0(1000/s)", iterations, [](size_t) {
+    WTF_RATE_LIMITED_SCOPE0(1000, "EventBench#RateLimited");
+  });
+
+  RunBenchmark("WTF_COLLAPSIBLE_SCOPE0 [collapsed]", iterations, [](size_t) {
+    WTF_COLLAPSIBLE_SCOPE0(1000000, "EventBench#Collapsible");
+  });
+
+  // Disabled category: the only cost should be the mask check.
+  wtf::EventEnabled<> event_category{"EventBench#Category", 1 << 1};
+  wtf::EventCategories::set_enabled(wtf::EventCategories::kDefault);
+  RunBenchmark("EventIf::Invoke() [category disabled]", iterations,
+               [&event_category](size_t) {
+                 ClobberMemory();
+                 event_category.Invoke();
+               });
+  wtf::EventCategories::set_enabled(wtf::EventCategories::kAll);
+
+  // Disabled thread: the only cost should be the thread local lookup.
+  runtime->DisableCurrentThread();
+  RunBenchmark("EventIf::Invoke() [thread disabled]", iterations,
+               [&event0](size_t) {
+                 ClobberMemory();
+                 event0.Invoke();
+               });
+  RunBenchmark("AutoScopeIf(int32) [thread disabled]", iterations,
+               [&scoped1](size_t i) {
+                 ClobberMemory();
+                 wtf::AutoScopeEnabled<int32_t> scope{scoped1};
+                 scope.Enter(i);
+               });
+
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "wtf/event.h"
 
+#include <cstring>
 #include <fstream>
 
 #include "gtest/gtest.h"
@@ -60,6 +61,113 @@ TEST_F(EventTest, CheckNameSpecParsing) {
   EXPECT_EQ(output, "int32 arg1, ascii a1");
 }
 
+TEST_F(EventTest, PackedArgumentLayout) {
+  EXPECT_EQ(0u, (CountArgSlots<>()));
+  EXPECT_EQ(1u, (CountArgSlots<uint8_t>()));
+  EXPECT_EQ(1u, (CountArgSlots<bool, int8_t, int16_t>()));
+  EXPECT_EQ(2u, (CountArgSlots<uint8_t, uint32_t>()));
+  EXPECT_EQ(2u, (CountArgSlots<uint8_t, uint16_t, uint16_t>()));
+  EXPECT_EQ(3u, (CountArgSlots<uint8_t, bool, uint16_t, uint32_t, int8_t>()));
+  EXPECT_EQ(2u, (CountArgSlots<bool, float>()));
+
+  auto packed = EventDefinition::Create<uint8_t, bool, uint16_t>(
+      /*wire_id=*/0, EventClass::kScoped, /*flags=*/0, "Packed: a, b, c");
+  EXPECT_EQ(int{EventFlags::kPackedArguments}, packed.flags());
+  EXPECT_EQ("uint8 a, bool b, uint16 c", packed.arguments());
+  auto unpacked = CreateEventDefinition("Unpacked");
+  EXPECT_EQ(0, unpacked.flags());
+}
+
+TEST_F(EventTest, PackedArgumentEmit) {
+  uint32_t slots[3] = {0xdeadbeef, 0xdeadbeef, 0xdeadbeef};
+  EmitArguments(nullptr, slots, static_cast<uint8_t>(1), true,
+                static_cast<uint16_t>(0x1234), static_cast<uint32_t>(7),
+                static_cast<int8_t>(-1));
+  EXPECT_EQ(0x12340101u, slots[0]);
+  EXPECT_EQ(7u, slots[1]);
+  EXPECT_EQ(0xffu, slots[2]);
+
+  // A lone byte after padding leaves the rest of the slot zeroed.
+  EmitArguments(nullptr, slots, static_cast<int16_t>(-2), false,
+                static_cast<int16_t>(3));
+  EXPECT_EQ(0x0000fffeu, slots[0]);
+  EXPECT_EQ(3u, slots[1]);
+}
+
+TEST_F(EventTest, WideArguments) {
+  EXPECT_EQ(2u, (CountArgSlots<uint64_t>()));
+  EXPECT_EQ(3u, (CountArgSlots<uint8_t, double>()));
+  EXPECT_EQ(5u, (CountArgSlots<int64_t, void*, bool>()));
+
+  auto event = EventDefinition::Create<uint64_t, int64_t, double, void*>(
+      /*wire_id=*/0, EventClass::kInstance, /*flags=*/0, "Wide: a, b, c, d");
+  EXPECT_EQ("uint64 a, int64 b, float64 c, pointer d", event.arguments());
+  EXPECT_EQ(0, event.flags());
+
+  uint32_t slots[8];
+  EmitArguments(nullptr, slots, static_cast<uint64_t>(0x123456789abcdef0ull),
+                static_cast<int64_t>(-2), 1.5,
+                reinterpret_cast<void*>(static_cast<uintptr_t>(0xfedc)));
+  EXPECT_EQ(0x9abcdef0u, slots[0]);
+  EXPECT_EQ(0x12345678u, slots[1]);
+  EXPECT_EQ(0xfffffffeu, slots[2]);
+  EXPECT_EQ(0xffffffffu, slots[3]);
+  EXPECT_EQ(0u, slots[4]);
+  EXPECT_EQ(0x3ff80000u, slots[5]);
+  EXPECT_EQ(0xfedcu, slots[6]);
+  EXPECT_EQ(0u, slots[7]);
+}
+
+TEST_F(EventTest, ArrayArguments) {
+  EXPECT_EQ(3u, (CountArgSlots<uint8_t, Array<uint16_t>, bool>()));
+  EXPECT_EQ(1u, (CountVariableArgs<uint8_t, Array<uint16_t>, bool>()));
+  EXPECT_EQ(1 + EventBuffer::kMaximumInlineArraySlotCount,
+            static_cast<size_t>(EventEnabled<Blob>::kMaximumArgSlotCount));
+
+  auto event = EventDefinition::Create<Array<uint16_t>, Blob, Array<float>>(
+      /*wire_id=*/0, EventClass::kInstance, /*flags=*/0, "Arrays: a, b, c");
+  EXPECT_EQ("uint16[] a, uint8[] b, float32[] c", event.arguments());
+
+  // Arguments after an array follow its data.
+  const uint16_t values[] = {1, 2, 3};
+  Array<uint16_t> array{values, 3};
+  EXPECT_EQ(2u, CountExtraArgSlots(static_cast<uint8_t>(5), array, true));
+  uint32_t slots[5];
+  EmitArguments(nullptr, slots, static_cast<uint8_t>(5), array, true);
+  EXPECT_EQ(5u, slots[0]);
+  EXPECT_EQ(3u, slots[1]);
+  EXPECT_EQ(0x00020001u, slots[2]);
+  EXPECT_EQ(0x00000003u, slots[3]);
+  EXPECT_EQ(1u, slots[4]);
+
+  // Null arrays have no data.
+  EXPECT_EQ(0u, CountExtraArgSlots(Blob{nullptr, 4}));
+  EmitArguments(nullptr, slots, Blob{nullptr, 4});
+  EXPECT_EQ(0xffffffffu, slots[0]);
+}
+
+TEST_F(EventTest, InlineStringArguments) {
+  auto event = EventDefinition::Create<InlineString, const char*>(
+      /*wire_id=*/0, EventClass::kInstance, /*flags=*/0, "Strings: a, b");
+  EXPECT_EQ("char[] a, ascii b", event.arguments());
+
+  InlineString path{"/index.html"};
+  EXPECT_EQ(3u, CountExtraArgSlots(path));
+  uint32_t slots[5];
+  EmitArguments(nullptr, slots, path, static_cast<int32_t>(-1));
+  EXPECT_EQ(11u, slots[0]);
+  EXPECT_EQ(0, std::memcmp(slots + 1, "/index.html\0", 12));
+  EXPECT_EQ(0xffffffffu, slots[4]);
+
+  // Long strings are truncated, and null ones recorded as null.
+  std::string long_string(InlineString::kMaximumLength * 2, 'x');
+  EXPECT_EQ(static_cast<size_t>(InlineString::kMaximumLength),
+            InlineString{long_string}.length());
+  EXPECT_EQ(0u, CountExtraArgSlots(InlineString{nullptr}));
+  EmitArguments(nullptr, slots, InlineString{nullptr});
+  EXPECT_EQ(0xffffffffu, slots[0]);
+}
+
 }  // namespace
 }  // namespace wtf
 
@@ -2,18 +2,80 @@
 #ifndef TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_ARGTYPES_H_
 #define TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_ARGTYPES_H_
 
+#include <cstring>
 #include <string>
 
 #include "wtf/buffer.h"
 
 namespace wtf {
+
+// A borrowed array of values to record as an event argument. Only the
+// pointer and size are held, so the data must outlive the event invocation.
+// A null data pointer is recorded as a null array.
+template <typename T>
+class Array {
+ public:
+  Array(const T* data, size_t size) : data_{data}, size_{size} {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const T* data_;
+  size_t size_;
+};
+
+// Opaque bytes to record as an event argument (as a uint8[]).
+class Blob : public Array<uint8_t> {
+ public:
+  Blob(const void* data, size_t size)
+      : Array<uint8_t>{static_cast<const uint8_t*>(data), size} {}
+};
+
+// A borrowed string to record directly in the event rather than interning
+// it in the StringTable. Interned strings are never freed, so this suits
+// strings that are rarely repeated (i.e. request paths or user ids).
+// Strings longer than kMaximumLength bytes are truncated.
+class InlineString {
+ public:
+  static constexpr size_t kMaximumLength = 64;
+
+  InlineString(const char* value, size_t length)
+      : value_{value},
+        length_{length < kMaximumLength
+                    ? length
+                    : static_cast<size_t>(kMaximumLength)} {}
+  explicit InlineString(const char* value)
+      : InlineString{value,
+                     value ? std::char_traits<char>::length(value) : 0} {}
+  explicit InlineString(const std::string& value)
+      : InlineString{value.data(), value.size()} {}
+
+  const char* value() const { return value_; }
+  size_t length() const { return length_; }
+
+ private:
+  const char* value_;
+  size_t length_;
+};
+
 namespace types {
 
 // ArgTypeDef for each supported type provides the WTF type name and a
 // function for emitting values of the type.
+//
+// Types smaller than 32 bits instead give their size as kPackedBytes and a
+// Pack() function returning their bits. Several of them can share a slot
+// (see EmitArguments()).
+//
+// Types with kVariableLength set (arrays) use kSlotCount slots plus the
+// number given by ExtraSlotCount() for each value, and their Emit() returns
+// that number.
 template <typename ArgType>
 struct ArgTypeDef {
   static const size_t kSlotCount = 0;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static const char* type_name() { return "unknown"; }
   static void Emit(EventBuffer* b, uint32_t* slots, ArgType value) {}
 };
@@ -22,6 +84,8 @@ struct ArgTypeDef {
 template <>
 struct ArgTypeDef<const char*> {
   static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static const char* type_name() { return "ascii"; }
   static void Emit(EventBuffer* b, uint32_t* slots, const char* value) {
     int string_id = value ? b->string_table()->GetStringId(value)
@@ -34,32 +98,66 @@ struct ArgTypeDef<const char*> {
 template <>
 struct ArgTypeDef<const std::string> {
   static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static const char* type_name() { return "ascii"; }
   static void Emit(EventBuffer* b, uint32_t* slots, const std::string& value) {
     int string_id = value.empty()
                         ? StringTable::kEmptyStringId
-                        : b->string_table()->GetStringId(value.c_str());
+                        : b->string_table()->GetStringId(value);
     slots[0] = string_id;
   }
 };
 
+// std::string -> ascii
+// Top level const is dropped when deducing argument types, so this is the
+// definition that EmitArguments() sees for Event<const std::string>.
+template <>
+struct ArgTypeDef<std::string> : ArgTypeDef<const std::string> {};
+
+// StaticString -> ascii
+// Resolved through a per-buffer cache indexed by the StaticString, so the
+// hot path is a single array lookup.
+template <>
+struct ArgTypeDef<StaticString> {
+  static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
+  static const char* type_name() { return "ascii"; }
+  static void Emit(EventBuffer* b, uint32_t* slots, const StaticString& value) {
+    slots[0] = b->string_table()->GetStringId(value);
+  }
+};
+
 template <typename T>
 struct Base32BitIntegralArgTypeDef {
   static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static void Emit(EventBuffer* b, uint32_t* slots, T value) {
     slots[0] = static_cast<uint32_t>(value);
   }
 };
 
+template <typename T>
+struct BasePackedIntegralArgTypeDef {
+  static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = sizeof(T);
+  static const bool kVariableLength = false;
+  static uint32_t Pack(T value) {
+    return static_cast<uint32_t>(value) & ((1u << (8 * sizeof(T))) - 1);
+  }
+};
+
 // uint8_t -> uint8
 template <>
-struct ArgTypeDef<uint8_t> : Base32BitIntegralArgTypeDef<uint8_t> {
+struct ArgTypeDef<uint8_t> : BasePackedIntegralArgTypeDef<uint8_t> {
   static const char* type_name() { return "uint8"; }
 };
 
 // uint16_t -> uint16
 template <>
-struct ArgTypeDef<uint16_t> : Base32BitIntegralArgTypeDef<uint16_t> {
+struct ArgTypeDef<uint16_t> : BasePackedIntegralArgTypeDef<uint16_t> {
   static const char* type_name() { return "uint16"; }
 };
 
@@ -71,13 +169,13 @@ struct ArgTypeDef<uint32_t> : Base32BitIntegralArgTypeDef<uint32_t> {
 
 // int8_t -> int8
 template <>
-struct ArgTypeDef<int8_t> : Base32BitIntegralArgTypeDef<int8_t> {
+struct ArgTypeDef<int8_t> : BasePackedIntegralArgTypeDef<int8_t> {
   static const char* type_name() { return "int8"; }
 };
 
 // int16_t -> int16
 template <>
-struct ArgTypeDef<int16_t> : Base32BitIntegralArgTypeDef<int16_t> {
+struct ArgTypeDef<int16_t> : BasePackedIntegralArgTypeDef<int16_t> {
   static const char* type_name() { return "int16"; }
 };
 
@@ -87,33 +185,55 @@ struct ArgTypeDef<int32_t> : Base32BitIntegralArgTypeDef<int32_t> {
   static const char* type_name() { return "int32"; }
 };
 
+// 64 bit values take two slots: the low 32 bits, then the high 32 bits.
 template <typename T>
 struct Base64BitIntegralArgTypeDef {
-  // TODO(laurenzo): WTF does not natively support 64 bit types. We just
-  // truncate them until fixed.
-  static const size_t kSlotCount = 1;
+  static const size_t kSlotCount = 2;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static void Emit(EventBuffer* b, uint32_t* slots, T value) {
-    slots[0] = static_cast<uint32_t>(value);
+    uint64_t bits = static_cast<uint64_t>(value);
+    slots[0] = static_cast<uint32_t>(bits);
+    slots[1] = static_cast<uint32_t>(bits >> 32);
   }
 };
 
-// uint64_t -> uint32
+// uint64_t -> uint64
 template <>
 struct ArgTypeDef<uint64_t> : Base64BitIntegralArgTypeDef<uint64_t> {
-  static const char* type_name() { return "uint32"; }
+  static const char* type_name() { return "uint64"; }
 };
 
-// int64_t -> int32
+// int64_t -> int64
 template <>
 struct ArgTypeDef<int64_t> : Base64BitIntegralArgTypeDef<int64_t> {
-  static const char* type_name() { return "int32"; }
+  static const char* type_name() { return "int64"; }
+};
+
+// void* -> pointer
+// Other pointers must be cast, so that i.e. a char* is not mistaken for a
+// string.
+template <>
+struct ArgTypeDef<const void*> {
+  static const char* type_name() { return "pointer"; }
+  static const size_t kSlotCount = 2;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
+  static void Emit(EventBuffer* b, uint32_t* slots, const void* value) {
+    Base64BitIntegralArgTypeDef<uint64_t>::Emit(
+        b, slots, reinterpret_cast<uintptr_t>(value));
+  }
 };
+template <>
+struct ArgTypeDef<void*> : ArgTypeDef<const void*> {};
 
 // float -> float32
 template <>
 struct ArgTypeDef<float> {
   static const char* type_name() { return "float32"; }
   static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
   static void Emit(EventBuffer* b, uint32_t* slots, float value) {
     union {
       float float_value;
@@ -124,14 +244,128 @@ struct ArgTypeDef<float> {
   }
 };
 
+// double -> float64
+template <>
+struct ArgTypeDef<double> {
+  static const char* type_name() { return "float64"; }
+  static const size_t kSlotCount = 2;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = false;
+  static void Emit(EventBuffer* b, uint32_t* slots, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    Base64BitIntegralArgTypeDef<uint64_t>::Emit(b, slots, bits);
+  }
+};
+
+// Array<T> -> T[]
+// A length slot followed by the data, padded to a whole slot, or if that
+// would take more than kMaximumInlineArraySlotCount slots, kOutOfLineArray
+// followed by the id of a copy in the EventBuffer's ResourceTable.
+template <typename T>
+struct BaseArrayArgTypeDef {
+  static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = true;
+  static size_t ExtraSlotCount(const Array<T>& value) {
+    if (!value.data()) {
+      return 0;
+    }
+    size_t count = (value.size() * sizeof(T) + 3) / 4;
+    return count <= EventBuffer::kMaximumInlineArraySlotCount ? count : 1;
+  }
+  static size_t Emit(EventBuffer* b, uint32_t* slots, const Array<T>& value) {
+    if (!value.data()) {
+      slots[0] = 0xffffffff;
+      return 0;
+    }
+    size_t length = value.size() * sizeof(T);
+    size_t count = (length + 3) / 4;
+    if (count > EventBuffer::kMaximumInlineArraySlotCount) {
+      slots[0] = EventBuffer::kOutOfLineArray;
+      slots[1] = b->resource_table()->AddResource(value.data(), length);
+      return 1;
+    }
+    slots[0] = static_cast<uint32_t>(value.size());
+    if (count) {
+      slots[count] = 0;
+      std::memcpy(slots + 1, value.data(), length);
+    }
+    return count;
+  }
+};
+
+template <>
+struct ArgTypeDef<Array<int8_t>> : BaseArrayArgTypeDef<int8_t> {
+  static const char* type_name() { return "int8[]"; }
+};
+template <>
+struct ArgTypeDef<Array<uint8_t>> : BaseArrayArgTypeDef<uint8_t> {
+  static const char* type_name() { return "uint8[]"; }
+};
+template <>
+struct ArgTypeDef<Array<int16_t>> : BaseArrayArgTypeDef<int16_t> {
+  static const char* type_name() { return "int16[]"; }
+};
+template <>
+struct ArgTypeDef<Array<uint16_t>> : BaseArrayArgTypeDef<uint16_t> {
+  static const char* type_name() { return "uint16[]"; }
+};
+template <>
+struct ArgTypeDef<Array<int32_t>> : BaseArrayArgTypeDef<int32_t> {
+  static const char* type_name() { return "int32[]"; }
+};
+template <>
+struct ArgTypeDef<Array<uint32_t>> : BaseArrayArgTypeDef<uint32_t> {
+  static const char* type_name() { return "uint32[]"; }
+};
+template <>
+struct ArgTypeDef<Array<float>> : BaseArrayArgTypeDef<float> {
+  static const char* type_name() { return "float32[]"; }
+};
+
+// Blob -> uint8[]
+template <>
+struct ArgTypeDef<Blob> : ArgTypeDef<Array<uint8_t>> {};
+
+// InlineString -> char[]
+// A length slot followed by the characters, padded to a whole slot.
+template <>
+struct ArgTypeDef<InlineString> {
+  static const char* type_name() { return "char[]"; }
+  static const size_t kSlotCount = 1;
+  static const size_t kPackedBytes = 0;
+  static const bool kVariableLength = true;
+  static_assert(InlineString::kMaximumLength <=
+                    EventBuffer::kMaximumInlineArraySlotCount * 4,
+                "Inline strings must fit the space reserved for arrays.");
+  static size_t ExtraSlotCount(const InlineString& value) {
+    return (value.length() + 3) / 4;
+  }
+  static size_t Emit(EventBuffer* b, uint32_t* slots,
+                     const InlineString& value) {
+    if (!value.value()) {
+      slots[0] = 0xffffffff;
+      return 0;
+    }
+    size_t count = (value.length() + 3) / 4;
+    slots[0] = static_cast<uint32_t>(value.length());
+    if (count) {
+      slots[count] = 0;
+      std::memcpy(slots + 1, value.value(), value.length());
+    }
+    return count;
+  }
+};
+
 // bool -> bool
 template <>
 struct ArgTypeDef<bool> {
   static const char* type_name() { return "bool"; }
   static const size_t kSlotCount = 1;
-  static void Emit(EventBuffer* b, uint32_t* slots, bool value) {
-    slots[0] = value ? 1 : 0;
-  }
+  static const size_t kPackedBytes = 1;
+  static const bool kVariableLength = false;
+  static uint32_t Pack(bool value) { return value ? 1 : 0; }
 };
 
 // Does a compile time assert that the type is supported.
@@ -44,9 +44,14 @@ class OutputBuffer {
     written_ += len;
   }
 
-  void AppendUint32(uint32_t value) {
+  void AppendUint32(uint32_t value) { AppendUint32s(&value, 1); }
+
+  // Appends a contiguous span of 32bit values with a single write. This is
+  // the preferred way to emit bulk data (i.e. EventBuffer chunks) since each
+  // call to Append() goes through the virtual ostream::write machinery.
+  void AppendUint32s(const uint32_t* values, size_t count) {
     // TODO(laurenzo): Byte swap BE.
-    Append(static_cast<void*>(&value), sizeof(uint32_t));
+    Append(static_cast<const void*>(values), count * sizeof(uint32_t));
   }
 
   void Align() {
@@ -65,15 +70,46 @@ class OutputBuffer {
   // with proper alignment.
   void StartChunk(ChunkHeader header, PartHeader* parts, size_t part_count);
 
+  // Returns the total length in bytes, including headers, of a chunk
+  // consisting of the given parts.
+  static size_t ChunkLength(const PartHeader* parts, size_t part_count);
+
  private:
   size_t written_ = 0;
   std::ostream* out_;
 };
 
+// A string whose contents never change for the life of the process
+// (typically a literal). Each instance is assigned a process wide index at
+// construction so that a StringTable can resolve it to a string id with a
+// single array lookup, without hashing. Instances are normally created once
+// per call site via WTF_STATIC_STRING and passed as event arguments of type
+// StaticString.
+class StaticString {
+ public:
+  explicit StaticString(const char* value);
+
+  const char* value() const { return value_; }
+  size_t index() const { return index_; }
+
+ private:
+  static platform::atomic<size_t> next_index_;
+  const char* value_;
+  size_t index_;
+};
+
 // Maintains canonical strings.
 //
-// There should be one shared StringTable for all threads. This class is thread
-// safe.
+// Each EventBuffer has its own StringTable, which follows the same
+// threading rules: at most one thread interning strings (the writer) and
+// one thread serializing (the reader). Interning never takes a lock: the
+// writer looks strings up in a private open-addressed table and appends new
+// ones to a list that is published to the reader with a release store of its
+// serialized length.
+//
+// Published strings never change or move, so the length noted by
+// PopulateHeader() is an immutable snapshot: WriteTo() reads it while the
+// writer keeps appending, and slow output never stalls the writer.
 //
 // Strings in WTF are common in metadata and are technically allowed in
 // regular events. Their use, however, is not optimized for the latter case.
@@ -84,30 +120,262 @@ class StringTable {
   void operator=(const StringTable&) = delete;
 
   static constexpr int kEmptyStringId = -1;
+
+  // The part types of a full table and of a delta, which continues the
+  // table written by previous saves of the same buffer.
+  static constexpr uint32_t kPartType = 0x30000;
+  static constexpr uint32_t kDeltaPartType = 0x30001;
+
+  // Marks how much of the table has been written by previous saves.
+  struct Watermark {
+    size_t count = 0;
+    size_t raw_length = 0;
+  };
+
   StringTable();
+  ~StringTable();
 
   // Get the id for a string.
-  int GetStringId(const std::string& str);
+  // Access: Writer thread.
+  int GetStringId(const char* str, size_t length);
+  int GetStringId(const char* str) {
+    return GetStringId(str, std::char_traits<char>::length(str));
+  }
+  int GetStringId(const std::string& str) {
+    return GetStringId(str.data(), str.size());
+  }
+  int GetStringId(const StaticString& str) {
+    size_t index = str.index();
+    if (index < static_string_ids_.size() && static_string_ids_[index]) {
+      return static_string_ids_[index] - 1;
+    }
+    return AddStaticString(str);
+  }
 
   // Populate the part header for this part.
   // Note that this should be called *after* any bits that may have contributed
   // to the table so that it includes at least as many strings as have been
   // referenced.
+  // Access: Reader thread.
   void PopulateHeader(OutputBuffer::PartHeader* header);
 
   // Writes the string table to the OutputBuffer using a header previously
   // computed via PopulateHeader. Note that the table may have grown since
   // then and only the amount noted will be written.
   // Returns: Whether the table was serialized properly.
+  // Access: Reader thread.
   bool WriteTo(OutputBuffer::PartHeader* header, OutputBuffer* output_buffer);
 
+  // As PopulateHeader() and WriteTo(), but for a delta part holding only
+  // the strings added since 'watermark'. A successful write advances the
+  // watermark past the strings written.
+  // Access: Reader thread.
+  void PopulateDeltaHeader(OutputBuffer::PartHeader* header,
+                           const Watermark& watermark);
+  bool WriteDeltaTo(OutputBuffer::PartHeader* header,
+                    OutputBuffer* output_buffer, Watermark* watermark);
+
   // Clears the string table. Intended for testing.
   void Clear();
 
  private:
-  platform::mutex mu_;
-  std::vector<std::string> strings_;
-  std::unordered_map<std::string, int> strings_to_id_;
+  // Strings are appended to a linked list of fixed size blocks so that they
+  // never move once published.
+  static constexpr size_t kBlockSize = 64;
+  struct Block {
+    std::string strings[kBlockSize];
+    platform::atomic<Block*> next{nullptr};
+  };
+
+  // An entry in the open-addressed lookup table. An id of kEmptyStringId
+  // marks an unused entry.
+  struct Entry {
+    uint32_t hash = 0;
+    int id = kEmptyStringId;
+  };
+
+  // Doubles the size of the lookup table and rehashes.
+  // Access: Writer thread.
+  void GrowEntries();
+
+  // Slow path for GetStringId(StaticString): interns the string and caches
+  // its id.
+  // Access: Writer thread.
+  int AddStaticString(const StaticString& str);
+
+  // String id + 1 for each StaticString index seen, or 0 if not yet seen.
+  // Access: Writer thread.
+  std::vector<int> static_string_ids_;
+
+  // Lookup table (always a power of two in size).
+  // Access: Writer thread.
+  std::vector<Entry> entries_;
+
+  // Blocks indexed by id / kBlockSize, for resolving lookups.
+  // Access: Writer thread.
+  std::vector<Block*> blocks_;
+  size_t count_ = 0;
+  size_t raw_length_ = 0;
+
+  // The first block. Set at construction.
+  // Access: Reader thread (and writer thread via blocks_).
+  Block* head_;
+
+  // The serialized length (sum of sizes plus null terminators) of all
+  // strings that have been published.
+  // Access: Written by writer, read by reader.
+  platform::atomic<size_t> published_raw_length_{0};
+};
+
+// Accounts for the chunk and resource memory held by a set of EventBuffers
+// against a shared limit. The Runtime keeps one of these for all thread
+// buffers so that a burst of events (or threads) cannot exhaust process
+// memory.
+// This class is thread safe.
+class MemoryBudget {
+ public:
+  MemoryBudget() = default;
+  MemoryBudget(const MemoryBudget&) = delete;
+  void operator=(const MemoryBudget&) = delete;
+
+  // Sets the limit in bytes. 0 (the default) is unlimited. Lowering the
+  // limit below the current usage does not free anything; it just causes
+  // further reservations to fail until usage drops.
+  void set_limit_bytes(size_t limit_bytes) {
+    limit_bytes_.store(limit_bytes, platform::memory_order_relaxed);
+  }
+  size_t limit_bytes() {
+    return limit_bytes_.load(platform::memory_order_relaxed);
+  }
+
+  // The number of bytes currently reserved.
+  size_t used_bytes() {
+    return used_bytes_.load(platform::memory_order_relaxed);
+  }
+
+  // Reserves 'bytes', failing without reserving anything if that would
+  // exceed the limit.
+  bool TryReserve(size_t bytes);
+
+  // Unconditionally reserves 'bytes' (i.e. for memory that already exists).
+  void ForceReserve(size_t bytes);
+
+  // Returns bytes previously reserved.
+  void Release(size_t bytes);
+
+ private:
+  platform::atomic<size_t> limit_bytes_{0};
+  platform::atomic<size_t> used_bytes_{0};
+};
+
+// Holds the payloads of array arguments too large to be stored inline in
+// their events. Each is serialized as a binary resource part (0x40000)
+// following the event data in the buffer's chunk, and events refer to it by
+// its id.
+//
+// Resources are freed once a clearing save has written every event that
+// refers to them, so ids keep counting up. When the first resource in a
+// chunk is not id 0, a resource base part (0x40002) holding its id as a
+// uint32 precedes the resource parts. Payloads are charged to the memory
+// budget, if any. One that does not fit is not stored and gets
+// kDroppedResourceId, which readers treat as a missing (null) array.
+class ResourceTable {
+ public:
+  static constexpr uint32_t kPartType = 0x40000;
+  static constexpr uint32_t kBasePartType = 0x40002;
+  static constexpr uint32_t kDroppedResourceId = 0xffffffff;
+
+  // Disallow copy/assignment.
+  ResourceTable(const ResourceTable&) = delete;
+  void operator=(const ResourceTable&) = delete;
+
+  ResourceTable();
+  ~ResourceTable();
+
+  // Stores a copy of 'length' bytes of 'data' and returns its id.
+  // Access: Writer thread.
+  uint32_t AddResource(const void* data, size_t length);
+
+  // Notes that the events referring to every resource added so far have
+  // been published. Called by EventBuffer::Flush().
+  // Access: Writer thread.
+  void Flush() {
+    if (flushed_count_ != count_) {
+      flushed_count_ = count_;
+      published_flushed_count_.store(count_, platform::memory_order_release);
+    }
+  }
+
+  // The number of resources whose events had been published. Loaded before
+  // an EventBuffer snapshot, every resource below it is referred to only by
+  // events in the snapshot.
+  // Access: Reader thread.
+  size_t flushed_count() {
+    return published_flushed_count_.load(platform::memory_order_acquire);
+  }
+
+  // Allows resources below 'count' to be freed by the next WriteTo().
+  // Access: Reader thread.
+  void ReleaseBelow(size_t count) {
+    if (count > release_count_) {
+      release_count_ = count;
+    }
+  }
+
+  // Charges held and future payloads to 'budget', as
+  // EventBuffer::SetMemoryBudget() does for chunks.
+  // Access: Writer thread (or prior to the buffer becoming shared).
+  void SetMemoryBudget(MemoryBudget* budget);
+
+  // Appends a part header for each resource published so far that has not
+  // been freed, preceded by a base part if the first of them is not id 0.
+  // Access: Reader thread.
+  void PopulateHeaders(std::vector<OutputBuffer::PartHeader>* headers);
+
+  // Writes the resources noted by PopulateHeaders(), then frees those that
+  // ReleaseBelow() allowed. 'output_buffer' may be null to only free.
+  // Returns: Whether the resources were serialized properly.
+  // Access: Reader thread.
+  bool WriteTo(const std::vector<OutputBuffer::PartHeader>& headers,
+               OutputBuffer* output_buffer);
+
+ private:
+  // Resources are appended to a linked list of fixed size blocks so that
+  // they never move once published.
+  static constexpr size_t kBlockSize = 16;
+  struct Block {
+    std::string resources[kBlockSize];
+    platform::atomic<Block*> next{nullptr};
+  };
+
+  // The last block.
+  // Access: Writer thread.
+  Block* tail_;
+  size_t count_ = 0;
+  size_t flushed_count_ = 0;
+
+  // The first block that has not been freed, which holds ids from
+  // head_id_. Set at construction.
+  // Access: Reader thread (and writer thread via tail_).
+  Block* head_;
+  size_t head_id_ = 0;
+
+  // The first id that has not been freed, and the id below which resources
+  // may be.
+  // Access: Reader thread.
+  size_t first_id_ = 0;
+  size_t release_count_ = 0;
+
+  // The budget and the payload bytes charged to it.
+  // Access: Writer thread (charging) and reader thread (freeing).
+  MemoryBudget* memory_budget_ = nullptr;
+  platform::atomic<size_t> allocated_bytes_{0};
+
+  // The number of resources that have been published, and the number whose
+  // events have been.
+  // Access: Written by writer, read by reader.
+  platform::atomic<size_t> published_count_{0};
+  platform::atomic<size_t> published_flushed_count_{0};
 };
 
 // Buffer for raw event data.
@@ -125,6 +393,31 @@ class EventBuffer {
   static constexpr size_t kMaximumAddSlotsCount =
       kMinimumChunkSizeBytes / sizeof(uint32_t);
 
+  // Event time slots hold the low 32 bits of a nanosecond timestamp, which
+  // wrap every ~4.3s. The writer adds a wtf.trace#timebase event whenever
+  // this long has passed since its previous event, so that consecutive
+  // events can always be unwrapped against each other.
+  static constexpr uint64_t kTimebaseIntervalNanos = 1ull << 30;
+
+  // The largest number of bytes that an event can take in compact encoding
+  // (see SetCompactEncoding()) is this plus 5 per argument slot: varints of
+  // up to 6 bytes for the wire id, 5 for the argument slot count and 10 for
+  // the time delta.
+  static constexpr size_t kMaximumCompactEventOverheadBytes = 6 + 5 + 10;
+  static constexpr size_t MaximumCompactEventBytes(size_t arg_slot_count) {
+    return kMaximumCompactEventOverheadBytes + 5 * arg_slot_count;
+  }
+
+  // The maximum number of argument slots that AddCompactEvent() accepts.
+  static constexpr size_t kMaximumCompactArgSlotCount =
+      (kMinimumChunkSizeBytes - kMaximumCompactEventOverheadBytes) / 5;
+
+  // Array arguments whose data takes up to this many slots are copied into
+  // their event. Larger ones are stored in the resource_table() and the
+  // event instead holds kOutOfLineArray followed by the resource id.
+  static constexpr size_t kMaximumInlineArraySlotCount = 64;
+  static constexpr uint32_t kOutOfLineArray = 0xfffffffe;
+
   // Singly linked list of chunks. A chunk is a sequence of 32bit slots that
   // keeps track of its fill level. Writing is always assumed to happen from
   // a single thread. Reading is expected to happen from at most one thread
@@ -138,7 +431,8 @@ class EventBuffer {
     // Access: Any thread.
     const size_t limit;
 
-    // The number of slots that have been filled.
+    // The number of slots that have been filled. This and the other sizes
+    // below count bytes rather than slots in compact encoding.
     // Access: Writer thread only.
     size_t size = 0;
 
@@ -160,6 +454,67 @@ class EventBuffer {
     // The number of slots that the reader should skip.
     // Access: Read and written by reader.
     size_t skip_count = 0;
+
+    // The time of the first event written to the chunk (or of the buffer's
+    // creation, for the initial chunk). Since the writer never lets more
+    // than kTimebaseIntervalNanos pass without a timebase, event times in
+    // the chunk can be unwrapped starting from here.
+    // Access: Written by writer before publishing the chunk, read by reader.
+    uint64_t base_time_nanos = 0;
+
+    // Whether events were dropped between the previous chunk and this one,
+    // in which case its first event cannot be unwrapped against the last
+    // event of the previous chunk.
+    // Access: Written by writer before publishing the chunk, read by reader.
+    bool needs_timebase = false;
+
+    // The reader's clock as of the save that last advanced skip_count. In
+    // compact encoding, the exact time of the last event skipped.
+    // Access: Read and written by reader.
+    uint64_t skip_time_nanos = 0;
+  };
+
+  // Spare chunks shared between EventBuffers, so that the memory of buffers
+  // being destroyed goes to buffers created later rather than to the heap.
+  // Pooled chunks stay charged to the memory budget given here, which must
+  // be the budget of every buffer using the pool. Holds at most
+  // 'max_chunk_count' chunks of one size, and none while the budget is
+  // exhausted, deleting any others.
+  // Access: Any thread.
+  class ChunkPool {
+   public:
+    ChunkPool(size_t max_chunk_count, MemoryBudget* memory_budget);
+    ~ChunkPool();
+
+    // Disallow copy/assignment.
+    ChunkPool(const ChunkPool&) = delete;
+    void operator=(const ChunkPool&) = delete;
+
+    size_t chunk_count();
+
+    // Deletes pooled chunks while the memory budget is over its limit.
+    void Trim();
+
+   private:
+    friend class EventBuffer;
+
+    // Whether the memory budget is over its limit.
+    bool OverBudget();
+
+    // Takes a chunk of the given limit, or returns nullptr if there is none
+    // or another thread holds the lock, so that writers never wait on it.
+    Chunk* Take(size_t limit);
+
+    // Adds a linked list of chunks to the pool, deleting those that do not
+    // fit. Returns: The bytes of the chunks that were kept.
+    size_t Give(Chunk* chunks);
+
+    platform::mutex mu_;
+    const size_t max_chunk_count_;
+    MemoryBudget* const memory_budget_;
+    size_t chunk_limit_ = 0;
+    size_t chunk_count_ = 0;
+    Chunk* chunks_ = nullptr;
   };
 
   // Disallow copy/assignment.
@@ -168,7 +523,13 @@ class EventBuffer {
 
   // Initializes with a custom chunk size, which specifies how much space
   // is reserved and how much the buffer expands by on overflow.
-  explicit EventBuffer(size_t chunk_size_bytes);
+  explicit EventBuffer(size_t chunk_size_bytes)
+      : EventBuffer(chunk_size_bytes, nullptr) {}
+
+  // Initializes as above, taking the head chunk and later ones from
+  // 'chunk_pool' where it has them and charging the rest to its memory
+  // budget, as SetMemoryBudget() and SetChunkPool() would.
+  EventBuffer(size_t chunk_size_bytes, ChunkPool* chunk_pool);
 
   // Initialize with a StringTable and defaults.
   EventBuffer() : EventBuffer(kDefaultChunkSizeBytes) {}
@@ -193,6 +554,41 @@ class EventBuffer {
     return slots;
   }
 
+  // Gets the value for an event's time slot: the low 32 bits of
+  // PlatformGetTimestampNanos64(). This must be called before AddSlots() for
+  // the event, since after an idle period it first adds a timebase event
+  // carrying the high bits.
+  // Access: Writer thread.
+  uint32_t GetEventTime() {
+    uint64_t now = PlatformGetTimestampNanos64();
+    uint64_t elapsed = now - last_event_time_nanos_;
+    last_event_time_nanos_ = now;
+    if (elapsed >= kTimebaseIntervalNanos) {
+      AddTimebase(now);
+    }
+    return static_cast<uint32_t>(now);
+  }
+
+  // Adds an event in compact encoding, taking its time from the clock. The
+  // caller must Flush() afterwards, as with AddSlots().
+  // It is illegal to call with count > kMaximumCompactArgSlotCount.
+  // Access: Writer thread.
+  void AddCompactEvent(uint32_t wire_id, const uint32_t* args, size_t count);
+
+  // Switches the buffer to a compact, variable length encoding of events.
+  // Each event is stored as base 128 varints: its wire id and argument slot
+  // count, the nanoseconds elapsed since the previous event, then one varint
+  // per argument slot. Scope leaves take 2-3 bytes instead of 8 and small
+  // arguments take 1-2 bytes instead of 4. The buffer is then serialized as a
+  // compact event buffer part (0x20003) instead of a binary one (0x20002).
+  // Events must then be added with AddCompactEvent() rather than AddSlots()
+  // and GetEventTime(), which the event classes do automatically.
+  // Access: Prior to any events being added.
+  void SetCompactEncoding(bool compact_encoding) {
+    compact_encoding_ = compact_encoding;
+  }
+  bool compact_encoding() { return compact_encoding_; }
+
   // To be called after initial slots have been added. They will be transferred
   // to frozen_prefix_slots_ and cleared from the EventBuffer proper. This
   // must be done prior to ordinary use of the EventBuffer. It is not possible
@@ -200,29 +596,194 @@ class EventBuffer {
   void FreezePrefixSlots();
 
   // Gets the frozen prefix slots that must be appended whenever the EventBuffer
-  // is serialized.
+  // is serialized. In compact encoding, the prefix is in
+  // frozen_prefix_bytes() instead.
   const std::vector<uint32_t>& frozen_prefix_slots() {
     return frozen_prefix_slots_;
   }
+  const std::vector<uint8_t>& frozen_prefix_bytes() {
+    return frozen_prefix_bytes_;
+  }
 
   // Flushes all pending calls to WriteSlots once data has been written. Note
   // that certain operations (i.e. chunk overflow) can cause flushing to
   // happen earlier.
   void Flush() {
-    // Publish the size.
+    // Publish the size, then that resources of the events up to it may be
+    // freed once written.
     current_->published_size.store(current_->size,
                                    platform::memory_order_release);
+    resource_table_.Flush();
+  }
+
+  // A position in the buffer that events added after it can be rewound to
+  // (see RewindTo()).
+  struct Mark {
+    size_t chunk_generation;
+    size_t size;
+    uint64_t last_event_time_nanos;
+  };
+
+  // Gets the current position of the writer.
+  // Access: Writer thread.
+  Mark GetMark() {
+    return Mark{chunk_generation_, current_->size, last_event_time_nanos_};
+  }
+
+  // Removes the events added since 'mark', provided that none of them have
+  // been published (by Flush() or by overflowing to another chunk), and
+  // returns whether it did. Events that a reader may have seen are never
+  // taken back.
+  // Access: Writer thread.
+  bool RewindTo(const Mark& mark) {
+    // The chunk may have been reused since, so it is identified by the
+    // number of chunks linked before it rather than by address.
+    Chunk* chunk = current_;
+    if (mark.chunk_generation != chunk_generation_ ||
+        chunk->published_size.load(platform::memory_order_relaxed) >
+            mark.size) {
+      return false;
+    }
+    chunk->size = mark.size;
+    last_event_time_nanos_ = mark.last_event_time_nanos;
+    return true;
   }
 
+  // The time of the most recently added event.
+  // Access: Writer thread.
+  uint64_t last_event_time_nanos() { return last_event_time_nanos_; }
+
   // Gets the string table for this buffer.
   StringTable* string_table() { return &string_table_; }
 
+  // Gets the table of out of line array payloads for this buffer.
+  ResourceTable* resource_table() { return &resource_table_; }
+
+  // Draws new chunks from 'pool' before the heap, and gives all chunks to it
+  // when the buffer is destroyed. The pool must outlive the buffer and use
+  // the same memory budget.
+  // Access: Prior to the buffer becoming shared.
+  void SetChunkPool(ChunkPool* pool) { chunk_pool_ = pool; }
+
+  // The zone that the buffer's events are attributed to, if the Runtime
+  // created one for it (0 otherwise).
+  // Access: Any thread (set prior to the buffer becoming shared).
+  int zone_id() const { return zone_id_; }
+  void set_zone_id(int zone_id) { zone_id_ = zone_id; }
+
+  // Identifies the buffer across the saves of a streamed trace, where it is
+  // the id of the buffer's chunks so that a reader can match string table
+  // deltas to the table they continue. Assigned by the Runtime.
+  // Access: Any thread (set prior to the buffer becoming shared).
+  uint32_t id() const { return id_; }
+  void set_id(uint32_t id) { id_ = id; }
+
+  // Puts the buffer into "flight recorder" mode, where it holds at most
+  // 'count' chunks (not counting the pool). Once full, each overflow recycles
+  // the oldest chunk instead of growing, so memory use is fixed and only the
+  // most recent data is retained. Serializing a buffer that has lost data in
+  // this way emits a wtf.trace#discontinuity event ahead of the oldest
+  // retained event. A count of 0 (the default) disables the limit; otherwise
+  // it is clamped to a minimum of 2.
+  // Access: Writer thread (or prior to the buffer becoming shared).
+  void SetMaximumChunkCount(size_t count) {
+    max_chunk_count_ = (count == 0 || count >= 2) ? count : 2;
+  }
+
+  // The number of chunks that have been overwritten in flight recorder mode.
+  // Access: Any thread.
+  size_t discarded_chunk_count() {
+    return discarded_chunk_count_.load(platform::memory_order_relaxed);
+  }
+
+  // Bytes in the chunks ahead of the one being written that a clearing write
+  // has yet to release. This is what saving would free up.
+  // Access: Any thread.
+  size_t unsaved_chunk_bytes() {
+    return (chunk_count_.load(platform::memory_order_relaxed) - 1) *
+           chunk_limit_ * sizeof(uint32_t);
+  }
+
+  // Charges all chunk and resource memory held by this buffer, now and in
+  // the future, against 'budget' (which must outlive the buffer). Once the
+  // budget is exhausted, events that would need a new chunk are dropped and
+  // counted rather than allocating, and large array payloads are recorded
+  // as missing. Serializing a buffer that has dropped events appends a
+  // wtf.trace#dropped event with the count.
+  // Access: Writer thread (or prior to the buffer becoming shared).
+  void SetMemoryBudget(MemoryBudget* budget);
+
+  // The number of events that have been dropped because the memory budget
+  // was exhausted.
+  // Access: Any thread.
+  size_t dropped_event_count() {
+    return dropped_event_count_.load(platform::memory_order_relaxed);
+  }
+
+  // State of a sampled or rate limited call site on the thread owning this
+  // buffer (see EventThrottleIf). Keeping it here rather than in the site
+  // means that sites need no synchronization.
+  struct ThrottleState {
+    // Invocations since the last recorded sample, or events recorded in the
+    // current rate limiting window.
+    uint32_t count = 0;
+
+    // Invocations skipped since the last wtf.trace#skipped event.
+    uint32_t skipped_count = 0;
+
+    // Start of the current rate limiting window.
+    uint64_t window_start_nanos = 0;
+
+    // Time of the last wtf.trace#skipped event.
+    uint64_t reported_nanos = 0;
+  };
+
+  // Gets the throttle state of the site with the given wire id.
+  // Access: Writer thread.
+  ThrottleState* throttle_state(int wire_id) {
+    size_t index = static_cast<size_t>(wire_id);
+    if (index >= throttle_states_.size()) {
+      throttle_states_.resize(index + 1);
+    }
+    return &throttle_states_[index];
+  }
+
+  // Readers must bracket the PopulateHeader() ... WriteTo() sequence with
+  // BeginRead()/EndRead() when the buffer may be in flight recorder mode.
+  // This keeps the writer from recycling chunks described by the header. The
+  // writer never blocks on it: if a read is in progress when it overflows,
+  // it grows past the maximum chunk count and trims back on a later overflow.
+  // Access: Reader thread.
+  void BeginRead() { read_mu_.lock(); }
+  void EndRead() { read_mu_.unlock(); }
+
+  // Allocates 'count' chunks up front and places them in the pool that
+  // overflow draws from, so that the writer does not hit the heap until they
+  // are exhausted. Chunks released by clearing writes are returned to the
+  // same pool, so in steady state (i.e. streaming saves) no allocation
+  // happens on the writer thread at all.
+  // Access: Writer thread (or prior to the buffer becoming shared).
+  void ReserveChunks(size_t count);
+
   // When the thread owning an EventBuffer dies, it may call this method,
   // which will allow the system to release the EventBuffer.
   void MarkOutOfScope() { out_of_scope_.store(true); }
 
+  // Whether MarkOutOfScope() has been called. Once it returns true, every
+  // event the thread wrote is visible to a subsequent PopulateHeader().
+  // Access: Any thread.
+  bool out_of_scope() { return out_of_scope_.load(); }
+
   // Populate the part header for this part.
-  void PopulateHeader(OutputBuffer::PartHeader* header);
+  // Each contiguous run of serialized events is preceded by a
+  // wtf.trace#timebase event (and so are the discontinuity and dropped
+  // events synthesized here), so a reader can reconstruct the full 64 bit
+  // time of every event.
+  // If max_age_micros is non-zero, leading chunks which only hold events older
+  // than that are left out of the snapshot (and a discontinuity is noted).
+  // This works at chunk granularity, so somewhat older events may be included.
+  void PopulateHeader(OutputBuffer::PartHeader* header,
+                      uint32_t max_age_micros = 0);
 
   // Writes the EventBuffer to the OutputBuffer using a header previously
   // populated via PopulateHeader(). Note that the buffer may have grown
@@ -238,6 +799,13 @@ class EventBuffer {
   bool WriteTo(OutputBuffer::PartHeader* header, OutputBuffer* output_buffer,
                bool clear_written_data);
 
+  // The nanosecond time range covered by the last PopulateHeader(): the
+  // first event after the frozen prefix through the time of the snapshot.
+  // A discontinuity, if any, is marked at the start time.
+  // Access: Reader thread.
+  uint64_t snapshot_start_time_nanos() { return snapshot_start_time_; }
+  uint64_t snapshot_end_time_nanos() { return snapshot_time_; }
+
   // Whether the event buffer is empty. It is only valid to call this from the
   // hosting thread.
   // Access: Testing only.
@@ -259,24 +827,138 @@ class EventBuffer {
   // This is only called in the overflow case of AddSlots().
   uint32_t* ExpandAndAddSlots(size_t count);
 
+  // Adds a timebase event for 'time'. The caller is about to add an event,
+  // whose Flush() publishes both.
+  // Access: Writer thread.
+  void AddTimebase(uint64_t time);
+
+  // Gets an empty chunk from the pool, allocating a new one if the pool is
+  // empty.
+  // Access: Writer thread.
+  Chunk* AllocateChunk();
+
+  // Allocates a chunk from the heap, charging the memory budget if there is
+  // one. Returns nullptr if the budget is exhausted.
+  // Access: Writer thread.
+  Chunk* NewChunk();
+
+  // Returns a chunk that the reader has finished with to the pool.
+  // Access: Reader thread.
+  void RecycleChunk(Chunk* chunk);
+
+  // In flight recorder mode, moves the oldest chunks to the free list until
+  // there is room for one more. No-op if a reader holds read_mu_.
+  // Access: Writer thread.
+  void DiscardOldestChunks();
+
   StringTable string_table_;
+  ResourceTable resource_table_;
+  uint32_t id_ = 0;
+  int zone_id_ = 0;
+  ChunkPool* chunk_pool_ = nullptr;
   size_t chunk_limit_;
+  bool compact_encoding_ = false;
   platform::atomic<bool> out_of_scope_{false};
 
+  // Maximum number of chunks in the list in flight recorder mode (0 for
+  // unbounded).
+  size_t max_chunk_count_ = 0;
+
+  // Number of chunks in the list from head_ to current_.
+  // Access: Writer and reader threads.
+  platform::atomic<size_t> chunk_count_{1};
+
+  // Number of chunks that have been overwritten by the writer.
+  // Access: Written by writer, read by reader.
+  platform::atomic<size_t> discarded_chunk_count_{0};
+
+  // Held by readers for the duration of a snapshot. In flight recorder mode,
+  // the writer only updates head_ while holding this.
+  platform::mutex read_mu_;
+
+  // Budget that chunk memory is charged against, if any.
+  // Access: Set prior to the buffer becoming shared.
+  MemoryBudget* memory_budget_ = nullptr;
+
+  // Bytes of chunk memory (in the list and in the pool) owned by this buffer.
+  // Access: Incremented by writer, decremented by reader.
+  platform::atomic<size_t> allocated_bytes_{0};
+
+  // Number of events dropped because the budget was exhausted.
+  // Access: Written by writer, read by reader.
+  platform::atomic<size_t> dropped_event_count_{0};
+
+  // Dropped events are written here and never published.
+  // Access: Writer thread.
+  uint32_t drop_slots_[kMaximumAddSlotsCount];
+
+  // Whether events have been dropped since the last chunk was linked.
+  // Access: Writer thread.
+  bool dropping_events_ = false;
+
+  // The time of the buffer's creation, which the frozen prefix is unwrapped
+  // against.
+  uint64_t creation_time_nanos_;
+
+  // The time of the most recent event.
+  // Access: Writer thread.
+  uint64_t last_event_time_nanos_;
+
+  // Snapshot state computed by PopulateHeader() and consumed by WriteTo().
+  // Access: Reader thread.
+  Chunk* snapshot_start_chunk_ = nullptr;
+  bool snapshot_has_discontinuity_ = false;
+  size_t snapshot_discarded_chunk_count_ = 0;
+  size_t snapshot_dropped_event_count_ = 0;
+  size_t snapshot_flushed_resource_count_ = 0;
+  uint64_t snapshot_start_time_ = 0;
+  uint64_t snapshot_time_ = 0;
+
+  // The value of discarded_chunk_count_ as of the last clearing write. Data
+  // after that point is known to be contiguous.
+  // Access: Reader thread.
+  size_t cleared_discarded_chunk_count_ = 0;
+
+  // The value of dropped_event_count_ as of the last clearing write.
+  // Access: Reader thread.
+  size_t cleared_dropped_event_count_ = 0;
+
+  // Throttle state of sampled and rate limited sites, indexed by wire id.
+  // Access: Writer thread.
+  std::vector<ThrottleState> throttle_states_;
+
   // Frozen slots that must be prepended whenever the EventBuffer is written
   // out. This contains any setup events that are needed when writing out
   // an EventBuffer and will be set at initialization time.
   std::vector<uint32_t> frozen_prefix_slots_;
+  std::vector<uint8_t> frozen_prefix_bytes_;
 
   // The head chunk. This is set at allocation time prior to the instance
   // becoming shared. The last chunk in the list is the only one that will
-  // ever be touched by the writer thread.
+  // ever be touched by the writer thread, except in flight recorder mode,
+  // where the writer may advance the head while holding read_mu_.
   // Access: Reader thread.
   Chunk* head_;
 
   // The current chunk that is being written.
   // Access: Writer thread only.
   Chunk* current_;
+
+  // Number of chunks that have been made current_ after the head chunk.
+  // Access: Writer thread only.
+  size_t chunk_generation_ = 0;
+
+  // Chunks that are ready for re-use by the writer, linked through their
+  // 'next' field. The writer pops from this private list and refills it by
+  // taking everything in recycled_chunks_ at once.
+  // Access: Writer thread only.
+  Chunk* free_chunks_ = nullptr;
+
+  // Chunks released by the reader, linked through their 'next' field. The
+  // reader pushes with a CAS and the writer only ever exchanges the whole
+  // list out, so there is no ABA hazard.
+  // Access: Pushed by reader, taken by writer.
+  platform::atomic<Chunk*> recycled_chunks_{nullptr};
 };
 
 }  // namespace wtf
@@ -26,47 +26,215 @@ struct EventFlags {
   static constexpr int kInternal = 1 << 3;
   static constexpr int kAppendScopeData = 1 << 4;
   static constexpr int kBuiltin = 1 << 5;
+
+  // Set automatically on events with arguments smaller than 32 bits, which
+  // are packed into shared slots (see EmitArguments()).
+  static constexpr int kPackedArguments = 1 << 7;
 };
 
-// Helper for counting the number of slots required to serialize a template
-// pack of types.
-// Counts the number of slots needed to store the arguments by recursing
-// over the list of types. Unlike with argument signature generation, this
-// doesn't need to be in order, so we use a simpler form of recursion.
+// Runtime switches for instrumented call sites.
+// Each event belongs to a category, which is one or more bits of a process
+// wide mask. Invoking an event whose category bits are all disabled does
+// nothing beyond a relaxed load and a branch, so noisy instrumentation can be
+// compiled in and only enabled while investigating. Events are in kDefault
+// unless given a category. All categories start enabled, or as given by the
+// WTF_CATEGORIES environment variable (i.e. WTF_CATEGORIES=0x5) when the
+// Runtime is created.
+//
+// The check is made when the event is invoked via the current thread (i.e.
+// Invoke(), Enter(), AutoScope), not by the *Specific() methods. AutoScopes
+// stay balanced if the mask changes while they are open, but manual
+// Enter()/Leave() pairs may not.
+class EventCategories {
+ public:
+  static constexpr uint32_t kDefault = 1;
+  static constexpr uint32_t kAll = 0xffffffff;
+
+  // Gets or sets the mask of enabled categories.
+  static uint32_t enabled() {
+    return enabled_.load(platform::memory_order_relaxed);
+  }
+  static void set_enabled(uint32_t categories) {
+    enabled_.store(categories, platform::memory_order_relaxed);
+  }
+
+  // Gets whether any of the given categories are enabled.
+  static bool IsEnabled(uint32_t categories) {
+    return (enabled() & categories) != 0;
+  }
+
+ private:
+  static platform::atomic<uint32_t> enabled_;
+};
+
+// Argument layout.
+// Arguments are laid out in order. Those smaller than 32 bits (see
+// ArgTypeDef::kPackedBytes) are packed at the next byte offset that is a
+// multiple of their size, so that i.e. a bool, a uint8_t and a uint16_t share
+// one slot. All other arguments start a new slot. This is C struct layout,
+// which is what readers assume for events flagged with kPackedArguments.
+// Variable length arguments (arrays) end with a run of extra slots only known
+// at runtime. Arguments that follow them are laid out the same way relative
+// to the end of that run.
+
+// Gets the byte offset at which an argument of type T is placed if the
+// preceding arguments end at 'offset'.
+template <typename T>
+constexpr size_t ArgByteOffset(size_t offset) {
+  return types::ArgTypeDef<T>::kPackedBytes
+             ? (offset + types::ArgTypeDef<T>::kPackedBytes - 1) /
+                   types::ArgTypeDef<T>::kPackedBytes *
+                   types::ArgTypeDef<T>::kPackedBytes
+             : (offset + 3) / 4 * 4;
+}
+
+// Gets the byte offset just past an argument of type T if the preceding
+// arguments end at 'offset'.
+template <typename T>
+constexpr size_t ArgByteEndOffset(size_t offset) {
+  return ArgByteOffset<T>(offset) +
+         (types::ArgTypeDef<T>::kPackedBytes
+              ? types::ArgTypeDef<T>::kPackedBytes
+              : types::ArgTypeDef<T>::kSlotCount * sizeof(uint32_t));
+}
+
+// Helper for laying out a template pack of types by recursing over the list
+// of types.
 template <size_t k, typename Enable = void>
-struct CountArgSlotsHelper {
+struct ArgLayoutHelper {
+  // Gets the byte offset just past the arguments if they start at 'offset'.
   template <typename T, typename... ArgTypes>
-  static constexpr size_t Count() {
-    return types::ArgTypeDef<T>::kSlotCount +
-           CountArgSlotsHelper<k - 1>::template Count<ArgTypes...>();
+  static constexpr size_t EndOffset(size_t offset) {
+    return ArgLayoutHelper<k - 1>::template EndOffset<ArgTypes...>(
+        ArgByteEndOffset<T>(offset));
+  }
+
+  // Gets whether any of the arguments are packed.
+  template <typename T, typename... ArgTypes>
+  static constexpr bool HasPacked() {
+    return types::ArgTypeDef<T>::kPackedBytes != 0 ||
+           ArgLayoutHelper<k - 1>::template HasPacked<ArgTypes...>();
+  }
+
+  // Counts the variable length arguments.
+  template <typename T, typename... ArgTypes>
+  static constexpr size_t VariableCount() {
+    return (types::ArgTypeDef<T>::kVariableLength ? 1 : 0) +
+           ArgLayoutHelper<k - 1>::template VariableCount<ArgTypes...>();
   }
 };
 template <size_t k>
-struct CountArgSlotsHelper<k, typename std::enable_if<k == 0>::type> {
+struct ArgLayoutHelper<k, typename std::enable_if<k == 0>::type> {
   template <typename... ArgTypes>
-  static constexpr size_t Count() {
+  static constexpr size_t EndOffset(size_t offset) {
     static_assert(sizeof...(ArgTypes) == 0,
                   "Should be the terminal specialization.");
+    return offset;
+  }
+  template <typename... ArgTypes>
+  static constexpr bool HasPacked() {
+    return false;
+  }
+  template <typename... ArgTypes>
+  static constexpr size_t VariableCount() {
     return 0;
   }
 };
+
+// Counts the number of slots needed to store the arguments, not counting the
+// extra slots of variable length arguments.
 template <typename... ArgTypes>
 constexpr size_t CountArgSlots() {
-  return CountArgSlotsHelper<sizeof...(
-      ArgTypes)>::template Count<ArgTypes...>();
+  return (ArgLayoutHelper<sizeof...(ArgTypes)>::template EndOffset<
+              ArgTypes...>(0) +
+          3) /
+         4;
 }
 
-// Emits a variable list of arguments for which an ArgTypeDef exists for each.
-// The slots array must contain at least as many slots as reported required by
-// CountArgSlots<ArgTypes...>().
-inline void EmitArguments(EventBuffer* event_buffer, uint32_t* slots) {}
+// Counts the variable length arguments.
+template <typename... ArgTypes>
+constexpr size_t CountVariableArgs() {
+  return ArgLayoutHelper<sizeof...(ArgTypes)>::template VariableCount<
+      ArgTypes...>();
+}
+
+// Counts the extra slots needed by the variable length arguments among
+// 'args'. This is 0 at compile time if there are none.
+inline size_t CountExtraArgSlots() { return 0; }
 template <typename T, typename... RestArgTypes>
-void EmitArguments(EventBuffer* event_buffer, uint32_t* slots, T first,
-                   RestArgTypes... rest) {
-  using Def = types::ArgTypeDef<T>;
+typename std::enable_if<!types::ArgTypeDef<T>::kVariableLength, size_t>::type
+CountExtraArgSlots(const T& first, const RestArgTypes&... rest) {
+  return CountExtraArgSlots(rest...);
+}
+template <typename T, typename... RestArgTypes>
+typename std::enable_if<types::ArgTypeDef<T>::kVariableLength, size_t>::type
+CountExtraArgSlots(const T& first, const RestArgTypes&... rest) {
+  return types::ArgTypeDef<T>::ExtraSlotCount(first) +
+         CountExtraArgSlots(rest...);
+}
+
+// Gets the EventFlags implied by the argument types.
+template <typename... ArgTypes>
+constexpr int GetArgFlags() {
+  return ArgLayoutHelper<sizeof...(ArgTypes)>::template HasPacked<
+             ArgTypes...>()
+             ? EventFlags::kPackedArguments
+             : 0;
+}
+
+// Emits a packed argument at byte offset kByteOffset. The first argument in
+// a slot assigns it, so that padding is zeroed. Returns the number of extra
+// slots used, as do the other overloads.
+template <size_t kByteOffset, typename T>
+typename std::enable_if<types::ArgTypeDef<T>::kPackedBytes != 0, size_t>::type
+EmitArgument(EventBuffer* event_buffer, uint32_t* slots, T value) {
+  uint32_t bits = types::ArgTypeDef<T>::Pack(value) << (8 * (kByteOffset % 4));
+  if (kByteOffset % 4 == 0) {
+    slots[kByteOffset / 4] = bits;
+  } else {
+    slots[kByteOffset / 4] |= bits;
+  }
+  return 0;
+}
+
+// Emits an argument that takes whole slots, starting at kByteOffset.
+template <size_t kByteOffset, typename T>
+typename std::enable_if<types::ArgTypeDef<T>::kPackedBytes == 0 &&
+                            !types::ArgTypeDef<T>::kVariableLength,
+                        size_t>::type
+EmitArgument(EventBuffer* event_buffer, uint32_t* slots, T value) {
+  types::ArgTypeDef<T>::Emit(event_buffer, slots + kByteOffset / 4, value);
+  return 0;
+}
+
+// Emits a variable length argument starting at kByteOffset.
+template <size_t kByteOffset, typename T>
+typename std::enable_if<types::ArgTypeDef<T>::kVariableLength, size_t>::type
+EmitArgument(EventBuffer* event_buffer, uint32_t* slots, T value) {
+  return types::ArgTypeDef<T>::Emit(event_buffer, slots + kByteOffset / 4,
+                                    value);
+}
+
+// Emits arguments that start after kByteOffset.
+template <size_t kByteOffset>
+inline void EmitArgumentsAt(EventBuffer* event_buffer, uint32_t* slots) {}
+template <size_t kByteOffset, typename T, typename... RestArgTypes>
+void EmitArgumentsAt(EventBuffer* event_buffer, uint32_t* slots, T first,
+                     RestArgTypes... rest) {
   types::AssertTypeDef<T>::Assert();
-  Def::Emit(event_buffer, slots, first);
-  EmitArguments(event_buffer, slots + Def::kSlotCount, rest...);
+  size_t extra_slot_count = EmitArgument<ArgByteOffset<T>(kByteOffset)>(
+      event_buffer, slots, first);
+  EmitArgumentsAt<ArgByteEndOffset<T>(kByteOffset)>(
+      event_buffer, slots + extra_slot_count, rest...);
+}
+
+// Emits a variable list of arguments for which an ArgTypeDef exists for each.
+// The slots array must contain at least as many slots as reported required by
+// CountArgSlots<ArgTypes...>() plus CountExtraArgSlots(args...).
+template <typename... ArgTypes>
+void EmitArguments(EventBuffer* event_buffer, uint32_t* slots,
+                   ArgTypes... args) {
+  EmitArgumentsAt<0>(event_buffer, slots, args...);
 }
 
 // Value type that can be used to generate an event argument signature. This
@@ -86,7 +254,8 @@ class EventDefinition {
   template <typename... ArgTypes>
   static EventDefinition Create(int wire_id, EventClass event_class, int flags,
                                 const char* name_spec) {
-    return EventDefinition{wire_id, event_class, flags, name_spec,
+    return EventDefinition{wire_id, event_class,
+                           flags | GetArgFlags<ArgTypes...>(), name_spec,
                            &EventDefinition::ArgumentZipper<ArgTypes...>};
   }
 
@@ -217,23 +386,33 @@ class ZoneRegistry {
   // Gets the lone singleton instance.
   static ZoneRegistry* GetInstance();
 
-  // Creates a new zone, returning the id for it.
+  // Creates a new zone, returning the id for it. Ids of released zones are
+  // reused, so ids stay bounded by the number of zones alive at once.
   int CreateZone(const char* name, const char* type, const char* location);
 
-  // Registers all zones starting from the given from_index into EventBuffer.
-  // Returns: The 1 + the index of the last written zone.
-  int EmitZones(EventBuffer* event_buffer, size_t from_index);
+  // Releases a zone once nothing more will be saved for it. Its id may then
+  // be redefined by CreateZone(), which readers handle by attributing
+  // later events to the new definition.
+  void ReleaseZone(int zone_id);
+
+  // Registers all live zones created or redefined since the given sequence
+  // number into EventBuffer. Pass 0 to register all of them.
+  // Returns: The sequence number to pass next time.
+  size_t EmitZones(EventBuffer* event_buffer, size_t from_sequence);
 
  private:
   struct ZoneDefinition {
-    int id;
     std::string name;
     std::string type;
     std::string location;
+    size_t sequence = 0;
+    bool released = false;
   };
   platform::mutex mu_;
-  platform::atomic<int> next_zone_id_{1};
-  std::deque<ZoneDefinition> zone_definitions_;
+  size_t next_sequence_ = 1;
+  // Indexed by zone id - 1.
+  std::vector<ZoneDefinition> zone_definitions_;
+  std::vector<int> released_zone_ids_;
 
   ZoneRegistry();
   ZoneRegistry(const ZoneRegistry&) = delete;
@@ -264,46 +443,82 @@ class EventIf {
   static constexpr int kArgCount = sizeof...(ArgTypes);
   static constexpr size_t kEventPrefixSlotCount = 2;
   static constexpr size_t kArgSlotCount = CountArgSlots<ArgTypes...>();
-  static_assert((kArgSlotCount + kEventPrefixSlotCount) <=
+  // The most slots that the arguments can take, counting arrays stored
+  // inline.
+  static constexpr size_t kMaximumArgSlotCount =
+      kArgSlotCount + CountVariableArgs<ArgTypes...>() *
+                          EventBuffer::kMaximumInlineArraySlotCount;
+  static_assert((kMaximumArgSlotCount + kEventPrefixSlotCount) <=
                     EventBuffer::kMaximumAddSlotsCount,
                 "Arguments to event are too large to be allocated.");
+  static_assert(kMaximumArgSlotCount <=
+                    EventBuffer::kMaximumCompactArgSlotCount,
+                "Arguments to event are too large to be compactly encoded.");
 
   // Disallow copy and assign.
   EventIf(const EventIf&) = delete;
   void operator=(const EventIf&) = delete;
 
   // Creates a standard instance event.
-  explicit EventIf(const char* name_spec)
-      : EventIf(EventClass::kInstance, 0, name_spec) {}
+  explicit EventIf(const char* name_spec,
+                   uint32_t category = EventCategories::kDefault)
+      : EventIf(EventClass::kInstance, 0, name_spec, category) {}
 
   // Most general Event ctor for defining events of known wire_id. In practice,
   // this is only used for the primordial defineEvent.
-  EventIf(int wire_id, EventClass event_class, int flags, const char* name_spec)
-      : wire_id_(wire_id) {
+  EventIf(int wire_id, EventClass event_class, int flags, const char* name_spec,
+          uint32_t category = EventCategories::kDefault)
+      : wire_id_(wire_id), category_(category) {
     EventRegistry::AddEventDefinition(EventDefinition::Create<ArgTypes...>(
         wire_id, event_class, flags, name_spec));
   }
 
   // Creates an event with an auto-assigned id.
-  EventIf(EventClass event_class, int flags, const char* name_spec)
-      : EventIf(EventDefinition::NextEventId(), event_class, flags, name_spec) {
-  }
+  EventIf(EventClass event_class, int flags, const char* name_spec,
+          uint32_t category = EventCategories::kDefault)
+      : EventIf(EventDefinition::NextEventId(), event_class, flags, name_spec,
+                category) {}
 
   // ID of the event in the trace buffer.
   inline int wire_id() const { return wire_id_; }
 
+  // The EventCategories bits of the event.
+  inline uint32_t category() const { return category_; }
+  inline bool category_enabled() const {
+    return EventCategories::IsEnabled(category_);
+  }
+
   // Invokes the event with a specific EventBuffer.
   void InvokeSpecific(EventBuffer* event_buffer, ArgTypes... args) {
-    const size_t kSlotCount = kEventPrefixSlotCount + kArgSlotCount;
-    uint32_t* slots = event_buffer->AddSlots(kSlotCount);
+    AddSpecific(event_buffer, args...);
+    event_buffer->Flush();
+  }
+
+  // Adds the event to a specific EventBuffer without publishing it, so that
+  // it can still be removed with EventBuffer::RewindTo() until the next
+  // Flush().
+  void AddSpecific(EventBuffer* event_buffer, ArgTypes... args) {
+    size_t arg_slot_count = kArgSlotCount + CountExtraArgSlots(args...);
+    if (event_buffer->compact_encoding()) {
+      uint32_t arg_slots[kMaximumArgSlotCount ? kMaximumArgSlotCount : 1];
+      EmitArguments(event_buffer, arg_slots, args...);
+      event_buffer->AddCompactEvent(wire_id_, arg_slots, arg_slot_count);
+      return;
+    }
+    uint32_t time = event_buffer->GetEventTime();
+    uint32_t* slots =
+        event_buffer->AddSlots(kEventPrefixSlotCount + arg_slot_count);
     slots[0] = wire_id_;
-    slots[1] = PlatformGetTimestampMicros32();
+    slots[1] = time;
     EmitArguments(event_buffer, slots + kEventPrefixSlotCount, args...);
-    event_buffer->Flush();
   }
 
-  // Invokes the event against the current thread (if it has been enabled).
+  // Invokes the event against the current thread (if it has been enabled
+  // and the event's category is enabled).
   void Invoke(ArgTypes... args) {
+    if (!category_enabled()) {
+      return;
+    }
     EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
     if (event_buffer) {
       InvokeSpecific(event_buffer, args...);
@@ -312,6 +527,7 @@ class EventIf {
 
  private:
   int wire_id_;
+  uint32_t category_;
 };
 
 // Explicit specialization for when kEnable == false.
@@ -325,10 +541,11 @@ class EventIf<false, ArgTypes...> {
   EventIf(const EventIf&) = delete;
   void operator=(const EventIf&) = delete;
 
-  explicit EventIf(const char*) {}
+  explicit EventIf(const char*, uint32_t = 0) {}
   EventIf(int wire_id, EventClass event_class, int flags,
-          const char* name_spec) {}
-  EventIf(EventClass event_class, int flags, const char* name_spec) {}
+          const char* name_spec, uint32_t = 0) {}
+  EventIf(EventClass event_class, int flags, const char* name_spec,
+          uint32_t = 0) {}
 
   void InvokeSpecific(EventBuffer*, ArgTypes...) {}
   void Invoke(ArgTypes...) {}
@@ -356,6 +573,36 @@ class StandardEvents {
   static ScopeLeaveEventType& GetScopeLeaveEvent();
   static CreateZoneEventType& GetCreateZoneEvent();
 
+  // The discontinuity event is emitted by EventBuffer when serializing a
+  // buffer that has lost data (i.e. in flight recorder mode). Like scope leave,
+  // it has a fixed id and must be referenced before serializing.
+  using DiscontinuityEventType = EventEnabled<>;
+  static constexpr int kDiscontinuityEventId = 3;
+  static DiscontinuityEventType& GetDiscontinuityEvent();
+
+  // The dropped event is appended by EventBuffer when serializing a buffer
+  // that has dropped events because the memory budget was exhausted. Its
+  // argument is the number of events dropped since the last clearing save.
+  using DroppedEventsEventType = EventEnabled<uint32_t>;
+  static constexpr int kDroppedEventsEventId = 4;
+  static DroppedEventsEventType& GetDroppedEventsEvent();
+
+  // The timebase event supplies the high 32 bits of the nanosecond timeline
+  // (the low 32 bits are in its time slot, as with any event). Every other
+  // event only records the low 32 bits, so readers unwrap them against the
+  // most recent timebase. EventBuffer writes one ahead of each chunk's data
+  // when serializing, and the writer adds one whenever a thread has been
+  // idle for long enough that unwrapping would be ambiguous.
+  using TimebaseEventType = EventEnabled<uint32_t>;
+  static constexpr int kTimebaseEventId = 5;
+  static TimebaseEventType& GetTimebaseEvent();
+
+  // The skipped event reports how many invocations of the event with the
+  // given wire id a sampled or rate limited site has skipped on this thread
+  // since its previous report (see EventThrottleIf).
+  static void Skipped(EventBuffer* event_buffer, uint32_t wire_id,
+                      uint32_t count);
+
   static void DefineEvent(EventBuffer* event_buffer, uint16_t wire_id,
                           uint16_t event_class, uint32_t flags,
                           const char* name, const char* args);
@@ -379,6 +626,116 @@ class StandardEvents {
   StandardEvents() = delete;
 };
 
+// Decides which invocations of a sampled or rate limited call site are
+// recorded (see WTF_SAMPLED_EVENT and WTF_RATE_LIMITED_EVENT). The decision
+// is made per thread, against state kept in the thread's EventBuffer, so
+// hot sites cost a few loads and stores rather than a full event when
+// skipped. Skipped invocations are counted and reported with a
+// wtf.trace#skipped event ahead of the site's next recorded event (at most
+// once per kReportIntervalNanos after the first), so that totals can be
+// reconstructed, less whatever is still pending when the trace is saved.
+template <bool kEnable>
+class EventThrottleIf {
+ public:
+  static constexpr uint64_t kRateLimitWindowNanos = 1000000000;
+  static constexpr uint64_t kReportIntervalNanos = 100000000;
+
+  // Once over its limit, a rate limited site only checks whether the window
+  // has ended every this many invocations (a power of 2).
+  static constexpr uint32_t kRateLimitClockStride = 16;
+
+  // Returns whether to record this invocation of 'event' on the current
+  // thread, recording the first of every 'n' invocations.
+  template <typename EventType>
+  static bool Sample(const EventType& event, uint32_t n) {
+    EventBuffer* event_buffer = GetEventBuffer(event);
+    if (!event_buffer) {
+      return false;
+    }
+    auto state = event_buffer->throttle_state(event.wire_id());
+    uint32_t count = state->count;
+    state->count = count + 1 < n ? count + 1 : 0;
+    if (count) {
+      state->skipped_count++;
+      return false;
+    }
+    ReportSkipped(event_buffer, event.wire_id(), state);
+    return true;
+  }
+
+  // Returns whether to record this invocation of 'event' on the current
+  // thread, recording at most 'max_per_second' in each window of
+  // kRateLimitWindowNanos from the first event recorded in it. The clock is
+  // only read at the start of a window and periodically once the limit is
+  // hit, so a window may overrun by up to kRateLimitClockStride invocations.
+  template <typename EventType>
+  static bool RateLimit(const EventType& event, uint32_t max_per_second) {
+    EventBuffer* event_buffer = GetEventBuffer(event);
+    if (!event_buffer) {
+      return false;
+    }
+    auto state = event_buffer->throttle_state(event.wire_id());
+    if (state->count >= max_per_second) {
+      if (((state->skipped_count + 1) & (kRateLimitClockStride - 1)) ||
+          PlatformGetTimestampNanos64() - state->window_start_nanos <
+              kRateLimitWindowNanos) {
+        state->skipped_count++;
+        return false;
+      }
+      state->count = 0;
+    }
+    if (!state->count++) {
+      state->window_start_nanos = PlatformGetTimestampNanos64();
+    }
+    ReportSkipped(event_buffer, event.wire_id(), state);
+    return true;
+  }
+
+  // Emits a wtf.trace#skipped event for the invocations counted in 'state'
+  // if there are any and the last report was long enough ago.
+  static void ReportSkipped(EventBuffer* event_buffer, int wire_id,
+                            EventBuffer::ThrottleState* state) {
+    if (!state->skipped_count) {
+      return;
+    }
+    uint64_t now = PlatformGetTimestampNanos64();
+    if (state->reported_nanos &&
+        now - state->reported_nanos < kReportIntervalNanos) {
+      return;
+    }
+    StandardEvents::Skipped(event_buffer, wire_id, state->skipped_count);
+    state->skipped_count = 0;
+    state->reported_nanos = now;
+  }
+
+ private:
+  template <typename EventType>
+  static EventBuffer* GetEventBuffer(const EventType& event) {
+    if (!event.category_enabled()) {
+      return nullptr;
+    }
+    return PlatformGetThreadLocalEventBuffer();
+  }
+};
+
+// Explicit specialization for when kEnable == false.
+// This must have the same public surface area as the generic version but no-op.
+template <>
+class EventThrottleIf<false> {
+ public:
+  template <typename EventType>
+  static bool Sample(const EventType&, uint32_t) {
+    return false;
+  }
+  template <typename EventType>
+  static bool RateLimit(const EventType&, uint32_t) {
+    return false;
+  }
+};
+
+// Default instantiation of EventThrottleIf that is enabled if kMasterEnable.
+using EventThrottle = EventThrottleIf<kMasterEnable>;
+
 // Raw scope used to track enter and leave of a scope. This does not actually
 // do automatic RAII enter/exit, which is done by higher level wrapper types
 // and macros.
@@ -390,21 +747,68 @@ class ScopedEventIf : private EventIf<kEnable, ArgTypes...> {
   void operator=(const ScopedEventIf&) = delete;
 
   using EventIf<kEnable, ArgTypes...>::wire_id;
-
-  explicit ScopedEventIf(const char* name_spec)
-      : Event<ArgTypes...>(EventClass::kScoped, 0, name_spec) {}
+  using EventIf<kEnable, ArgTypes...>::category;
+  using EventIf<kEnable, ArgTypes...>::category_enabled;
+
+  // If minimum_duration_nanos is non-zero, scopes entered and left by
+  // AutoScopeIf that are shorter than it and contain no other published
+  // events are collapsed: removed from the buffer rather than left. The
+  // number collapsed on each thread is reported with wtf.trace#skipped
+  // events (see EventThrottleIf). Note that their enter events are not
+  // published, and so are invisible to a concurrent save, until the scope
+  // is left or something nested inside it is.
+  explicit ScopedEventIf(const char* name_spec,
+                         uint32_t category = EventCategories::kDefault,
+                         uint32_t minimum_duration_nanos = 0)
+      : Event<ArgTypes...>(EventClass::kScoped, 0, name_spec, category),
+        minimum_duration_nanos_(minimum_duration_nanos) {}
+
+  // The duration below which scopes are collapsed, or 0 if they never are.
+  uint32_t minimum_duration_nanos() const { return minimum_duration_nanos_; }
 
   // Emits an enter event against a specific EventBuffer.
   void EnterSpecific(EventBuffer* event_buffer, ArgTypes... args) {
     Event<ArgTypes...>::InvokeSpecific(event_buffer, args...);
   }
 
+  // Adds an unpublished enter event against a specific EventBuffer and
+  // returns the mark to pass to LeaveCollapsibleSpecific().
+  EventBuffer::Mark EnterCollapsibleSpecific(EventBuffer* event_buffer,
+                                             ArgTypes... args) {
+    EventBuffer::Mark mark = event_buffer->GetMark();
+    Event<ArgTypes...>::AddSpecific(event_buffer, args...);
+    return mark;
+  }
+
+  // Leaves a scope entered with EnterCollapsibleSpecific(), collapsing it if
+  // it is short enough and nothing inside it has been published. Scopes that
+  // are kept report the count of those collapsed before them.
+  void LeaveCollapsibleSpecific(EventBuffer* event_buffer,
+                                const EventBuffer::Mark& enter_mark) {
+    auto state = event_buffer->throttle_state(wire_id());
+    if (PlatformGetTimestampNanos64() - event_buffer->last_event_time_nanos() <
+            minimum_duration_nanos_ &&
+        event_buffer->RewindTo(enter_mark)) {
+      state->skipped_count++;
+      return;
+    }
+    LeaveSpecific(event_buffer);
+    EventThrottleIf<true>::ReportSkipped(event_buffer, wire_id(), state);
+  }
+
   // Emits a leave event against a specific EventBuffer.
   void LeaveSpecific(EventBuffer* event_buffer) {
     // We directly emit the scope leave event to avoid some overhead.
+    if (event_buffer->compact_encoding()) {
+      event_buffer->AddCompactEvent(StandardEvents::kScopeLeaveEventId,
+                                    nullptr, 0);
+      event_buffer->Flush();
+      return;
+    }
+    uint32_t time = event_buffer->GetEventTime();
     uint32_t* slots = event_buffer->AddSlots(2);
     slots[0] = StandardEvents::kScopeLeaveEventId;
-    slots[1] = PlatformGetTimestampMicros32();
+    slots[1] = time;
     event_buffer->Flush();
   }
 
@@ -412,6 +816,9 @@ class ScopedEventIf : private EventIf<kEnable, ArgTypes...> {
   // This is here for completeness: The RAII wrappers use
   // EnterSpecific/LeaveSpecific directly for efficiency.
   void Enter(ArgTypes... args) {
+    if (!category_enabled()) {
+      return;
+    }
     EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
     if (event_buffer) {
       EnterSpecific(event_buffer, args...);
@@ -422,11 +829,17 @@ class ScopedEventIf : private EventIf<kEnable, ArgTypes...> {
   // This is here for completeness: The RAII wrappers use
   // EnterSpecific/LeaveSpecific directly for efficiency.
   void Leave() {
+    if (!category_enabled()) {
+      return;
+    }
     EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
     if (event_buffer) {
       LeaveSpecific(event_buffer);
     }
   }
+
+ private:
+  uint32_t minimum_duration_nanos_;
 };
 
 // Appends arguments to the currently active scope.
@@ -437,10 +850,11 @@ class AppendScopeIf : private EventIf<kEnable, ArgTypes...> {
   AppendScopeIf(const AppendScopeIf&) = delete;
   void operator=(const AppendScopeIf&) = delete;
 
-  explicit AppendScopeIf(const char* name_spec)
+  explicit AppendScopeIf(const char* name_spec,
+                         uint32_t category = EventCategories::kDefault)
       : Event<ArgTypes...>(EventClass::kInstance,
                            EventFlags::kInternal | EventFlags::kAppendScopeData,
-                           name_spec) {}
+                           name_spec, category) {}
 
   using EventIf<kEnable, ArgTypes...>::Invoke;
 };
@@ -454,7 +868,7 @@ class AppendScopeIf<false, ArgTypes...> {
   AppendScopeIf(const AppendScopeIf&) = delete;
   void operator=(const AppendScopeIf&) = delete;
 
-  explicit AppendScopeIf(const char* name_spec) {}  // NOLINT
+  explicit AppendScopeIf(const char* name_spec, uint32_t = 0) {}  // NOLINT
 
   void Invoke(ArgTypes... args) {}
 };
@@ -477,19 +891,32 @@ class AutoScopeIf {
   void operator=(const AutoScopeIf&) = delete;
 
   explicit AutoScopeIf(EventType& event)  // NOLINT
-      : event_(event), event_buffer_(nullptr) {}
+      : event_(event), event_buffer_(nullptr), enter_mark_() {}
 
   // Even though it makes the API a bit fragile, having a separate Enter()
   // function is more compatible with macro invocation.
   void Enter(ArgTypes... args) {
+    if (!event_.category_enabled()) {
+      return;
+    }
     event_buffer_ = PlatformGetThreadLocalEventBuffer();
-    if (event_buffer_) {
+    if (!event_buffer_) {
+      return;
+    }
+    if (event_.minimum_duration_nanos()) {
+      enter_mark_ = event_.EnterCollapsibleSpecific(event_buffer_, args...);
+    } else {
       event_.EnterSpecific(event_buffer_, args...);
     }
   }
 
   ~AutoScopeIf() {
-    if (event_buffer_) {
+    if (!event_buffer_) {
+      return;
+    }
+    if (event_.minimum_duration_nanos()) {
+      event_.LeaveCollapsibleSpecific(event_buffer_, enter_mark_);
+    } else {
       event_.LeaveSpecific(event_buffer_);
     }
   }
@@ -497,6 +924,7 @@ class AutoScopeIf {
  private:
   EventType& event_;
   EventBuffer* event_buffer_;
+  EventBuffer::Mark enter_mark_;
 };
 
 // Explicit specialization for when kEnable == false.
@@ -530,7 +958,7 @@ class ScopedEventIf<false, ArgTypes...> {
   ScopedEventIf(const ScopedEventIf&) = delete;
   void operator=(const ScopedEventIf&) = delete;
 
-  explicit ScopedEventIf(const char*) {}
+  explicit ScopedEventIf(const char*, uint32_t = 0, uint32_t = 0) {}
   void EnterSpecific(EventBuffer*, ArgTypes...) {}
   void LeaveSpecific(EventBuffer*) {}
   void Enter(ArgTypes... args) {}
@@ -73,10 +73,9 @@
 //
 // Example:
 //   WTF_EVENT0("MyClass#something_important");
-#define WTF_EVENT0(name_spec)                                       \
-  static __INTERNAL_WTF_NAMESPACE::EventIf<kWtfEnabledForNamespace> \
-      __WTF_INTERNAL_UNIQUE(__wtf_event0__){name_spec};             \
-  __WTF_INTERNAL_UNIQUE(__wtf_event0__).Invoke()
+#define WTF_EVENT0(name_spec) \
+  WTF_CATEGORY_EVENT0(__INTERNAL_WTF_NAMESPACE::EventCategories::kDefault, \
+                      name_spec)
 
 // Shortcut to trace an event with arbitrary arguments.
 // Allowed Scopes: Within a function.
@@ -85,12 +84,42 @@
 //
 // Example:
 //   WTF_EVENT("MyClass#stuff: arg_name_1, arg_name_2", int, uint32_t)(1, 2);
-#define WTF_EVENT(name_spec, ...)                                   \
+#define WTF_EVENT(name_spec, ...)                                           \
+  WTF_CATEGORY_EVENT(__INTERNAL_WTF_NAMESPACE::EventCategories::kDefault, \
+                     name_spec, __VA_ARGS__)
+
+// Same as WTF_EVENT0 and WTF_EVENT but in the given EventCategories bits,
+// so that the call site can be switched off at runtime.
+//
+// Example:
+//   constexpr uint32_t kVerbose = 1 << 1;
+//   WTF_CATEGORY_EVENT(kVerbose, "MyClass#detail: i", int32_t)(i);
+#define WTF_CATEGORY_EVENT0(category, name_spec)                    \
+  static __INTERNAL_WTF_NAMESPACE::EventIf<kWtfEnabledForNamespace> \
+      __WTF_INTERNAL_UNIQUE(__wtf_event0__){name_spec, category};   \
+  __WTF_INTERNAL_UNIQUE(__wtf_event0__).Invoke()
+
+#define WTF_CATEGORY_EVENT(category, name_spec, ...)                \
   static __INTERNAL_WTF_NAMESPACE::EventIf<kWtfEnabledForNamespace, \
                                            __VA_ARGS__>             \
-      __WTF_INTERNAL_UNIQUE(__wtf_eventn__){name_spec};             \
+      __WTF_INTERNAL_UNIQUE(__wtf_eventn__){name_spec, category};   \
   __WTF_INTERNAL_UNIQUE(__wtf_eventn__).Invoke
 
+// Wraps a string literal (or other immutable string) as a StaticString for
+// use as an argument of type wtf::StaticString. The StaticString is created
+// once per call site, and each EventBuffer interns it on first use. After
+// that, logging it costs the same as logging an integer.
+// Allowed Scopes: Within a function.
+//
+// Example:
+//   WTF_EVENT("MyClass#state: name", wtf::StaticString)(
+//       WTF_STATIC_STRING("idle"));
+#define WTF_STATIC_STRING(literal)                                  \
+  ([]() -> const __INTERNAL_WTF_NAMESPACE::StaticString& {          \
+    static const __INTERNAL_WTF_NAMESPACE::StaticString s{literal}; \
+    return s;                                                       \
+  }())
+
 // Shortcut to trace a no-arg scope.
 // Allowed Scopes: Within a function.
 // This creates an anonymous scope anchored to the specific location in the
@@ -99,13 +128,9 @@
 //
 // Example:
 //   WTF_SCOPE0("MyClass#MyMethod");
-#define WTF_SCOPE0(name_spec)                                             \
-  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace> \
-      __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_){name_spec};              \
-  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace>          \
-      __WTF_INTERNAL_UNIQUE(__wtf_scope0_){                               \
-          __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_)};                    \
-  __WTF_INTERNAL_UNIQUE(__wtf_scope0_).Enter()
+#define WTF_SCOPE0(name_spec) \
+  WTF_CATEGORY_SCOPE0(__INTERNAL_WTF_NAMESPACE::EventCategories::kDefault, \
+                      name_spec)
 
 // Shortcut to trace a scope with arbitrary arguments.
 // Allowed Scopes: Within a function.
@@ -115,13 +140,134 @@
 //
 // Example:
 //   WTF_SCOPE("MyClass#MyMethod: arg_name_1, arg_name_2", int, uint32_t)(1, 2);
-#define WTF_SCOPE(name_spec, ...)                                             \
+#define WTF_SCOPE(name_spec, ...)                                           \
+  WTF_CATEGORY_SCOPE(__INTERNAL_WTF_NAMESPACE::EventCategories::kDefault, \
+                     name_spec, __VA_ARGS__)
+
+// Same as WTF_SCOPE0 and WTF_SCOPE but in the given EventCategories bits,
+// so that the call site can be switched off at runtime.
+//
+// Example:
+//   WTF_CATEGORY_SCOPE0(kVerbose, "MyClass#MyHelper");
+#define WTF_CATEGORY_SCOPE0(category, name_spec)                          \
+  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace> \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_){name_spec, category};    \
+  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace>          \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope0_){                               \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_)};                    \
+  __WTF_INTERNAL_UNIQUE(__wtf_scope0_).Enter()
+
+#define WTF_CATEGORY_SCOPE(category, name_spec, ...)                          \
+  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace,     \
+                                                 __VA_ARGS__>                 \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_){name_spec, category};        \
+  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace, __VA_ARGS__> \
+      __WTF_INTERNAL_UNIQUE(__wtf_scopen_){                                   \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_)};                        \
+  __WTF_INTERNAL_UNIQUE(__wtf_scopen_).Enter
+
+// Same as WTF_EVENT0, WTF_EVENT, WTF_SCOPE0 and WTF_SCOPE but only recording
+// the first of every 'n' invocations on each thread. The number skipped is
+// reported periodically with wtf.trace#skipped events (see EventThrottleIf).
+// Allowed Scopes: Within a function.
+//
+// Example:
+//   WTF_SAMPLED_SCOPE(100, "MyClass#HotLoop: i", int32_t)(i);
+#define WTF_SAMPLED_EVENT0(n, name_spec) \
+  __WTF_INTERNAL_THROTTLED_EVENT0(Sample, n, name_spec)
+#define WTF_SAMPLED_EVENT(n, name_spec, ...) \
+  __WTF_INTERNAL_THROTTLED_EVENT(Sample, n, name_spec, __VA_ARGS__)
+#define WTF_SAMPLED_SCOPE0(n, name_spec) \
+  __WTF_INTERNAL_THROTTLED_SCOPE0(Sample, n, name_spec)
+#define WTF_SAMPLED_SCOPE(n, name_spec, ...) \
+  __WTF_INTERNAL_THROTTLED_SCOPE(Sample, n, name_spec, __VA_ARGS__)
+
+// Same as WTF_EVENT0, WTF_EVENT, WTF_SCOPE0 and WTF_SCOPE but recording at
+// most 'max_per_second' invocations per second on each thread. The number
+// skipped is reported periodically with wtf.trace#skipped events.
+// Allowed Scopes: Within a function.
+//
+// Example:
+//   WTF_RATE_LIMITED_EVENT(1000, "MyClass#packet: size", uint32_t)(size);
+#define WTF_RATE_LIMITED_EVENT0(max_per_second, name_spec) \
+  __WTF_INTERNAL_THROTTLED_EVENT0(RateLimit, max_per_second, name_spec)
+#define WTF_RATE_LIMITED_EVENT(max_per_second, name_spec, ...)       \
+  __WTF_INTERNAL_THROTTLED_EVENT(RateLimit, max_per_second, name_spec, \
+                                 __VA_ARGS__)
+#define WTF_RATE_LIMITED_SCOPE0(max_per_second, name_spec) \
+  __WTF_INTERNAL_THROTTLED_SCOPE0(RateLimit, max_per_second, name_spec)
+#define WTF_RATE_LIMITED_SCOPE(max_per_second, name_spec, ...)       \
+  __WTF_INTERNAL_THROTTLED_SCOPE(RateLimit, max_per_second, name_spec, \
+                                 __VA_ARGS__)
+
+#define __WTF_INTERNAL_THROTTLED_EVENT0(method, limit, name_spec)        \
+  static __INTERNAL_WTF_NAMESPACE::EventIf<kWtfEnabledForNamespace>      \
+      __WTF_INTERNAL_UNIQUE(__wtf_event0__){name_spec};                  \
+  if (__INTERNAL_WTF_NAMESPACE::EventThrottleIf<                         \
+          kWtfEnabledForNamespace>::method(                              \
+          __WTF_INTERNAL_UNIQUE(__wtf_event0__), limit))                 \
+  __WTF_INTERNAL_UNIQUE(__wtf_event0__).Invoke()
+
+#define __WTF_INTERNAL_THROTTLED_EVENT(method, limit, name_spec, ...)    \
+  static __INTERNAL_WTF_NAMESPACE::EventIf<kWtfEnabledForNamespace,      \
+                                           __VA_ARGS__>                  \
+      __WTF_INTERNAL_UNIQUE(__wtf_eventn__){name_spec};                  \
+  if (__INTERNAL_WTF_NAMESPACE::EventThrottleIf<                         \
+          kWtfEnabledForNamespace>::method(                              \
+          __WTF_INTERNAL_UNIQUE(__wtf_eventn__), limit))                 \
+  __WTF_INTERNAL_UNIQUE(__wtf_eventn__).Invoke
+
+#define __WTF_INTERNAL_THROTTLED_SCOPE0(method, limit, name_spec)             \
+  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace>     \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_){name_spec};                  \
+  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace>              \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope0_){                                   \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_)};                        \
+  if (__INTERNAL_WTF_NAMESPACE::EventThrottleIf<                              \
+          kWtfEnabledForNamespace>::method(                                   \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_), limit))                 \
+  __WTF_INTERNAL_UNIQUE(__wtf_scope0_).Enter()
+
+#define __WTF_INTERNAL_THROTTLED_SCOPE(method, limit, name_spec, ...)         \
   static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace,     \
                                                  __VA_ARGS__>                 \
       __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_){name_spec};                  \
   __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace, __VA_ARGS__> \
       __WTF_INTERNAL_UNIQUE(__wtf_scopen_){                                   \
           __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_)};                        \
+  if (__INTERNAL_WTF_NAMESPACE::EventThrottleIf<                              \
+          kWtfEnabledForNamespace>::method(                                   \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_), limit))                 \
+  __WTF_INTERNAL_UNIQUE(__wtf_scopen_).Enter
+
+// Same as WTF_SCOPE0 and WTF_SCOPE but the scope is removed from the buffer
+// when it lasts less than 'minimum_nanos' and contains no other recorded
+// events. The number removed is reported periodically with wtf.trace#skipped
+// events. This keeps short, uninteresting scopes in hot loops from filling
+// the buffer.
+// Allowed Scopes: Within a function.
+//
+// Example:
+//   WTF_COLLAPSIBLE_SCOPE(1000, "MyClass#Step: i", int32_t)(i);
+#define WTF_COLLAPSIBLE_SCOPE0(minimum_nanos, name_spec)                  \
+  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace> \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_){                         \
+          name_spec, __INTERNAL_WTF_NAMESPACE::EventCategories::kDefault, \
+          minimum_nanos};                                                 \
+  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace>          \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope0_){                               \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_event0_)};                    \
+  __WTF_INTERNAL_UNIQUE(__wtf_scope0_).Enter()
+
+#define WTF_COLLAPSIBLE_SCOPE(minimum_nanos, name_spec, ...)                  \
+  static __INTERNAL_WTF_NAMESPACE::ScopedEventIf<kWtfEnabledForNamespace,     \
+                                                 __VA_ARGS__>                 \
+      __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_){                             \
+          name_spec, __INTERNAL_WTF_NAMESPACE::EventCategories::kDefault,     \
+          minimum_nanos};                                                     \
+  __INTERNAL_WTF_NAMESPACE::AutoScopeIf<kWtfEnabledForNamespace, __VA_ARGS__> \
+      __WTF_INTERNAL_UNIQUE(__wtf_scopen_){                                   \
+          __WTF_INTERNAL_UNIQUE(__wtf_scope_eventn_)};                        \
   __WTF_INTERNAL_UNIQUE(__wtf_scopen_).Enter
 
 // Shortcut to append arguments to the currently active scope.
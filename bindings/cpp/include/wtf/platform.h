@@ -22,6 +22,10 @@ void PlatformInitializeThreading();
 // from the call to PlatformSetTimestampEpoch().
 uint32_t PlatformGetTimestampMicros32();
 
+// Gets the timestamp in nano-seconds from the same epoch. Unlike the 32 bit
+// micros, this does not wrap in any practical amount of time.
+uint64_t PlatformGetTimestampNanos64();
+
 // Gets the EventBuffer* for a thread (which may be nullptr).
 EventBuffer* PlatformGetThreadLocalEventBuffer();
 
@@ -36,6 +40,17 @@ std::string PlatformGetThreadName();
 
 }  // namespace wtf
 
+// Storage class for plain (POD) thread locals on the hot path, if the
+// toolchain supports it. This uses the initial-exec model so that an access
+// from any translation unit is a single load relative to the thread pointer,
+// with no TLS wrapper or __tls_get_addr call. Android is excluded since it
+// has historically only had emulated TLS. Define WTF_NO_FAST_TLS to disable
+// (i.e. for a shared library that will be dlopen'd late).
+#if defined(__GNUC__) && !defined(__ANDROID__) && !defined(WTF_NO_FAST_TLS)
+#define WTF_INTERNAL_FAST_TLS \
+  __thread __attribute__((tls_model("initial-exec")))
+#endif
+
 // Branch to for specific platform implementations.
 // This must match the checks in platform.cc.
 #if defined(__myriad__) && defined(__sparc__)
@@ -12,8 +12,16 @@ namespace wtf {
 namespace internal {
 pthread_key_t event_buffer_key;
 pthread_once_t initialize_threading_once = PTHREAD_ONCE_INIT;
+#if defined(WTF_INTERNAL_FAST_TLS)
+WTF_INTERNAL_FAST_TLS EventBuffer* thread_event_buffer = nullptr;
+#endif
 
 void EventBufferDtor(void* event_buffer) {
+#if defined(WTF_INTERNAL_FAST_TLS)
+  // Events from later destructors are dropped, since the buffer may be freed
+  // once it is out of scope.
+  thread_event_buffer = nullptr;
+#endif
   static_cast<EventBuffer*>(event_buffer)->MarkOutOfScope();
 }
 
@@ -32,6 +40,9 @@ void PlatformSetThreadLocalEventBuffer(EventBuffer* event_buffer) {
   pthread_once(&internal::initialize_threading_once,
                internal::InitializeThreadingOnce);
   pthread_setspecific(internal::event_buffer_key, event_buffer);
+#if defined(WTF_INTERNAL_FAST_TLS)
+  internal::thread_event_buffer = event_buffer;
+#endif
 }
 
 std::string PlatformGetThreadName() {
@@ -3,9 +3,12 @@
 #ifndef TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_AUX_PTHREADS_THREADED_INL_H_
 #define TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_AUX_PTHREADS_THREADED_INL_H_
 
+#include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 #include <atomic>
+#include <functional>
 #include <mutex>
 
 namespace wtf {
@@ -37,22 +40,74 @@ inline void call_once(once_flag& once, T func) {
   pthread_once(&once.flag, func);
 }
 
+// Background threads, as used by Runtime::StartStreaming(). Only the subset
+// of std::thread that is needed: start on construction and join.
+constexpr bool has_threads = true;
+class thread {
+ public:
+  template <class Callable>
+  explicit thread(Callable&& func) : func_(std::forward<Callable>(func)) {
+    started_ = pthread_create(&handle_, nullptr, &thread::Run, this) == 0;
+  }
+  thread(const thread&) = delete;
+  void operator=(const thread&) = delete;
+
+  void join() {
+    if (started_) {
+      pthread_join(handle_, nullptr);
+      started_ = false;
+    }
+  }
+
+ private:
+  static void* Run(void* self) {
+    static_cast<thread*>(self)->func_();
+    return nullptr;
+  }
+
+  std::function<void()> func_;
+  pthread_t handle_;
+  bool started_ = false;
+};
+
+inline void sleep_for_micros(uint64_t micros) {
+  struct timespec duration;
+  duration.tv_sec = static_cast<time_t>(micros / 1000000);
+  duration.tv_nsec = static_cast<long>((micros % 1000000) * 1000);  // NOLINT
+  while (nanosleep(&duration, &duration) != 0 && errno == EINTR) {
+  }
+}
+
 }  // namespace platform
 
 namespace internal {
 extern pthread_key_t event_buffer_key;
 extern pthread_once_t initialize_threading_once;
 
+#if defined(WTF_INTERNAL_FAST_TLS)
+// The current thread's EventBuffer, kept in fast TLS so that the lookup
+// inlines to a single load. The pthread key holds the same pointer, but only
+// so that its destructor runs on thread exit.
+extern WTF_INTERNAL_FAST_TLS EventBuffer* thread_event_buffer;
+#endif
+
 void InitializeThreadingOnce();
 
 }  // namespace internal
 
+#if defined(WTF_INTERNAL_FAST_TLS)
+// Initialization happens when a buffer is set, so lookups need not check.
+inline EventBuffer* PlatformGetThreadLocalEventBuffer() {
+  return internal::thread_event_buffer;
+}
+#else
 inline EventBuffer* PlatformGetThreadLocalEventBuffer() {
   pthread_once(&internal::initialize_threading_once,
                internal::InitializeThreadingOnce);
   return static_cast<EventBuffer*>(
       pthread_getspecific(internal::event_buffer_key));
 }
+#endif
 
 }  // namespace wtf
 
@@ -10,8 +10,8 @@ EventBuffer* event_buffer = nullptr;
 
 void PlatformInitializeThreading() {
   static bool initialized = false;
-  initialized = true;
   if (!initialized) {
+    initialized = true;
     PlatformInitialize();
   }
 }
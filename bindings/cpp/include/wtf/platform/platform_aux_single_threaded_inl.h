@@ -6,7 +6,11 @@ namespace wtf {
 // In this configuration, we provide skeletons of atomics and mutexes that
 // no-op.
 namespace platform {
-struct mutex {};
+struct mutex {
+  void lock() {}
+  bool try_lock() { return true; }
+  void unlock() {}
+};
 
 template <typename T>
 struct lock_guard {
@@ -28,16 +32,38 @@ template <typename T>
 struct atomic {
   T value;
 
-  T fetch_add(T increment) {
+  T fetch_add(T increment, memory_order order = memory_order_seq_cst) {
     value = value + increment;
     return value;
   }
 
+  T fetch_sub(T decrement, memory_order order = memory_order_seq_cst) {
+    T old_value = value;
+    value = value - decrement;
+    return old_value;
+  }
+
   void store(T new_value, memory_order order = memory_order_seq_cst) {
     value = new_value;
   }
   T load(memory_order order = memory_order_seq_cst) { return value; }
 
+  T exchange(T new_value, memory_order order = memory_order_seq_cst) {
+    T old_value = value;
+    value = new_value;
+    return old_value;
+  }
+
+  bool compare_exchange_weak(T& expected, T desired,
+                             memory_order order = memory_order_seq_cst) {
+    if (value == expected) {
+      value = desired;
+      return true;
+    }
+    expected = value;
+    return false;
+  }
+
   // Assignment conversion.
   void operator=(T& other) { value = other; }
   void operator=(const T& other) { value = other; }
@@ -46,6 +72,16 @@ struct atomic {
   operator T() { return value; }
 };
 
+// There are no background threads, so Runtime::StartStreaming() fails.
+constexpr bool has_threads = false;
+struct thread {
+  template <class Callable>
+  explicit thread(Callable&&) {}
+  void join() {}
+};
+
+inline void sleep_for_micros(uint64_t) {}
+
 using once_flag = struct { bool flag{false}; };
 template <class T>
 inline void call_once(once_flag& once, T func) {
@@ -10,10 +10,25 @@ namespace wtf {
 
 std::once_flag initialize_once_;
 
+namespace internal {
+#if defined(WTF_INTERNAL_FAST_TLS)
+WTF_INTERNAL_FAST_TLS EventBuffer* thread_event_buffer = nullptr;
+#else
+thread_local EventBuffer* thread_event_buffer = nullptr;
+#endif
+}  // namespace internal
+
+// Mirrors internal::thread_event_buffer. This only exists so that the
+// EventBuffer can be marked out of scope when the thread exits: a thread_local
+// with a destructor cannot be accessed across translation units without a
+// wrapper call, so it is kept off the hot path.
 thread_local struct ThreadLocalStorage {
   ThreadLocalStorage() = default;
   ~ThreadLocalStorage() {
     if (event_buffer) {
+      // Events from later thread_local destructors are dropped, since the
+      // buffer may be freed once it is out of scope.
+      internal::thread_event_buffer = nullptr;
       event_buffer->MarkOutOfScope();
     }
   }
@@ -21,10 +36,6 @@ thread_local struct ThreadLocalStorage {
   EventBuffer* event_buffer = nullptr;
 } storage_;
 
-EventBuffer* PlatformGetThreadLocalEventBuffer() {
-  return storage_.event_buffer;
-}
-
 void PlatformInitializeThreading() {
   std::call_once(initialize_once_, PlatformInitialize);
 }
@@ -32,6 +43,7 @@ void PlatformInitializeThreading() {
 void PlatformSetThreadLocalEventBuffer(EventBuffer* event_buffer) {
   std::call_once(initialize_once_, PlatformInitialize);
   storage_.event_buffer = event_buffer;
+  internal::thread_event_buffer = event_buffer;
 }
 
 std::string PlatformGetThreadName() {
@@ -5,6 +5,7 @@
 #define TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_AUX_STD_THREADED_INL_H_
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 #include <thread>
 
@@ -35,9 +36,30 @@ using std::memory_order_consume;
 using std::memory_order_relaxed;
 using std::memory_order_release;
 using std::memory_order_seq_cst;
+
+// Background threads, as used by Runtime::StartStreaming().
+constexpr bool has_threads = true;
+using thread = std::thread;
+
+inline void sleep_for_micros(uint64_t micros) {
+  std::this_thread::sleep_for(std::chrono::microseconds(micros));
+}
 }  // namespace platform
 
-EventBuffer* PlatformGetThreadLocalEventBuffer();
+namespace internal {
+// The current thread's EventBuffer, kept in fast TLS (if available) so that
+// the lookup inlines to a single load. Set via
+// PlatformSetThreadLocalEventBuffer().
+#if defined(WTF_INTERNAL_FAST_TLS)
+extern WTF_INTERNAL_FAST_TLS EventBuffer* thread_event_buffer;
+#else
+extern thread_local EventBuffer* thread_event_buffer;
+#endif
+}  // namespace internal
+
+inline EventBuffer* PlatformGetThreadLocalEventBuffer() {
+  return internal::thread_event_buffer;
+}
 
 }  // namespace wtf
 
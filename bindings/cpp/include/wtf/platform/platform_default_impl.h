@@ -1,15 +1,82 @@
 #ifndef TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_DEFAULT_IMPL_H_
 #define TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_DEFAULT_IMPL_H_
 
+#if defined(WTF_CYCLE_COUNTER_CLOCK) && defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
 #include "wtf/buffer.h"
 
 namespace wtf {
 
 namespace internal {
 uint64_t base_timestamp_nanos = 0;
+
+#if defined(WTF_CYCLE_COUNTER_CLOCK)
+bool use_cycle_counter = false;
+uint64_t base_ticks = 0;
+uint64_t nanos_per_tick_fixed = 0;
+
+namespace {
+// How long to sample both clocks for when the counter frequency must be
+// measured. This is paid once, at runtime startup.
+constexpr uint64_t kCalibrationNanos = 10 * 1000 * 1000;
+
+// Returns the counter frequency in Hz, or 0 if the counter is not usable.
+uint64_t GetTickFrequency() {
+#if defined(__x86_64__)
+  // Require an invariant TSC (CPUID.80000007H:EDX[8]) so that the rate does
+  // not change with power states.
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) ||
+      !(edx & (1 << 8))) {
+    return 0;
+  }
+
+  // Measure against steady_clock. Take the counter reading that is
+  // bracketed most tightly by clock reads at either end.
+  auto sample = [](uint64_t* nanos, uint64_t* ticks) {
+    uint64_t best_window = UINT64_MAX;
+    for (int i = 0; i < 5; i++) {
+      uint64_t start = GetNanoTime();
+      uint64_t t = GetTickCount64();
+      uint64_t end = GetNanoTime();
+      if (end - start < best_window) {
+        best_window = end - start;
+        *nanos = start + (end - start) / 2;
+        *ticks = t;
+      }
+    }
+  };
+  uint64_t start_nanos = 0, start_ticks = 0, end_nanos = 0, end_ticks = 0;
+  sample(&start_nanos, &start_ticks);
+  while (GetNanoTime() - start_nanos < kCalibrationNanos) {
+  }
+  sample(&end_nanos, &end_ticks);
+  return static_cast<uint64_t>(static_cast<double>(end_ticks - start_ticks) *
+                               1e9 / (end_nanos - start_nanos));
+#else
+  // The generic timer reports its own frequency.
+  uint64_t frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  return frequency;
+#endif
+}
+}  // namespace
+#endif  // WTF_CYCLE_COUNTER_CLOCK
 }  // namespace internal
 
 void PlatformInitialize() {
+#if defined(WTF_CYCLE_COUNTER_CLOCK)
+  // Anything at or below 1MHz is no better than steady_clock.
+  uint64_t frequency = internal::GetTickFrequency();
+  if (frequency > 1000000) {
+    internal::nanos_per_tick_fixed = static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(1000000000) << 32) / frequency);
+    internal::base_ticks = internal::GetTickCount64();
+    internal::use_cycle_counter = true;
+  }
+#endif
   internal::base_timestamp_nanos = internal::GetNanoTime();
 }
 
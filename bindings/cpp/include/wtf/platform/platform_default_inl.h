@@ -3,6 +3,14 @@
 
 #include <chrono>
 
+#if defined(WTF_CYCLE_COUNTER_CLOCK)
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#error "WTF_CYCLE_COUNTER_CLOCK is only supported on x86-64 and aarch64"
+#endif
+#endif
+
 namespace wtf {
 
 namespace internal {
@@ -13,10 +21,51 @@ inline uint64_t GetNanoTime() {
   return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
 }
 
+#if defined(WTF_CYCLE_COUNTER_CLOCK)
+// The cycle counter clock reads the CPU's constant rate counter (the
+// invariant TSC on x86-64, the generic timer's virtual count on aarch64)
+// instead of going through clock_gettime. PlatformInitialize() calibrates it
+// against steady_clock and computes a 32.32 fixed point multiplier, so that
+// conversion to nanos is one multiply and no divide. If the counter is not
+// usable (i.e. the TSC is not invariant), use_cycle_counter is false and we
+// fall back to steady_clock.
+//
+// Readings are converted as they are taken rather than stored raw and scaled
+// at save time: the writer compares event times in nanos (timebase
+// intervals, compact encoding deltas, short scope collapsing, rate limits),
+// so raw ticks would only move the multiply there.
+extern bool use_cycle_counter;
+extern uint64_t base_ticks;
+extern uint64_t nanos_per_tick_fixed;
+
+inline uint64_t GetTickCount64() {
+#if defined(__x86_64__)
+  return __rdtsc();
+#else
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#endif
+}
+#endif  // WTF_CYCLE_COUNTER_CLOCK
+
 }  // namespace internal
 
+inline uint64_t PlatformGetTimestampNanos64() {
+#if defined(WTF_CYCLE_COUNTER_CLOCK)
+  if (internal::use_cycle_counter) {
+    uint64_t ticks = internal::GetTickCount64() - internal::base_ticks;
+    return static_cast<uint64_t>(
+        (static_cast<unsigned __int128>(ticks) *
+         internal::nanos_per_tick_fixed) >>
+        32);
+  }
+#endif
+  return internal::GetNanoTime() - internal::base_timestamp_nanos;
+}
+
 inline uint32_t PlatformGetTimestampMicros32() {
-  return (internal::GetNanoTime() - internal::base_timestamp_nanos) / 1000;
+  return static_cast<uint32_t>(PlatformGetTimestampNanos64() / 1000);
 }
 
 }  // namespace wtf
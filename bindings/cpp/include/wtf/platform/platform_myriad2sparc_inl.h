@@ -39,6 +39,11 @@ __attribute__((always_inline)) inline uint32_t PlatformGetTimestampMicros32() {
   return static_cast<uint32_t>(ticks / internal::sysclks_per_us);
 }
 
+__attribute__((always_inline)) inline uint64_t PlatformGetTimestampNanos64() {
+  uint64_t ticks = internal::PlatformGetTickCount64() - internal::base_ticks;
+  return ticks * 1000 / internal::sysclks_per_us;
+}
+
 }  // namespace wtf
 
 #endif  // TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_PLATFORM_MYRIAD2SPARC_INL_H_
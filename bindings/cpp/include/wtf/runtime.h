@@ -1,6 +1,7 @@
 #ifndef TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_RUNTIME_H_
 #define TRACING_FRAMEWORK_BINDINGS_CPP_INCLUDE_WTF_RUNTIME_H_
 
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -52,6 +53,37 @@ namespace wtf {
 //                Runtime::SaveOptions::ForStreamingFile(&checkpoint)));
 //     sleep(5);
 //   }
+//
+// Background Streaming:
+// ---------------------
+// Alternatively, the Runtime can run the incremental save loop itself on a
+// thread of its own, writing each save to a sink (a file, a file descriptor
+// or a callback). Saves happen at a fixed interval and also whenever the
+// thread buffers accumulate enough unsaved data, so that memory stays
+// bounded without any application code.
+//
+// Example:
+//   Runtime::StreamingOptions options;
+//   options.interval_micros = 5000000;
+//   options.watermark_bytes = 16 * 1024 * 1024;
+//   assert(Runtime::GetInstance()->StartStreaming("streaming.wtf-trace",
+//                                                 options));
+//   ...
+//   Runtime::GetInstance()->StopStreaming();
+//
+// Flight Recorder:
+// ----------------
+// In this mode, each thread retains a fixed amount of its most recent data,
+// overwriting the oldest as it goes, and a snapshot is saved on demand (e.g.
+// when something goes wrong). Lost data shows up as a discontinuity event.
+//
+// Example:
+//   Runtime::GetRuntime()->SetPreallocatedChunkCount(64);
+//   Runtime::GetRuntime()->SetFlightRecorderChunkCount(64);
+//   ... enable threads and log ...
+//   assert(Runtime::GetRuntime()::SaveToFile(
+//              "recent.wtf-trace",
+//              Runtime::SaveOptions::ForRecent(10 * 1000000)));
 class Runtime {
  public:
   // A pointer to a SaveCheckpoint can be set in SaveOptions. Passing the
@@ -70,8 +102,14 @@ class Runtime {
     // The index of the first event definition that needs to be written out.
     size_t event_definition_from_index_ = 0;
 
-    // The index of the first zone registration that needs to be written out.
-    size_t zone_definition_from_index_ = 0;
+    // The ZoneRegistry sequence number of the first zone registration that
+    // needs to be written out.
+    size_t zone_definition_from_sequence_ = 0;
+
+    // How much of each thread's string table has been written out, keyed
+    // by EventBuffer id. Later saves only write the strings added since.
+    std::unordered_map<uint32_t, StringTable::Watermark>
+        string_table_watermarks_;
 
     friend class Runtime;
   };
@@ -112,6 +150,16 @@ class Runtime {
       return options;
     }
 
+    // Creates options configured to save only roughly the last
+    // 'max_age_micros' of thread data, which is cleared on save. Typically
+    // used to dump a flight recorder (see SetFlightRecorderChunkCount()).
+    static SaveOptions ForRecent(uint32_t max_age_micros) {
+      SaveOptions options;
+      options.clear_thread_data = true;
+      options.max_age_micros = max_age_micros;
+      return options;
+    }
+
     // If set, a checkpointed save will be done. Only updates from the last
     // save will be written and this field will be updated to reflect the
     // current state. This implies clear_thread_data and is generally best
@@ -122,12 +170,74 @@ class Runtime {
     // which currently includes the string table and event registration buffers.
     bool clear_thread_data = false;
 
+    // If non-zero, thread data older than this is left out of the save (and
+    // discarded if clearing). This is applied at EventBuffer chunk
+    // granularity, so some older events may be included.
+    uint32_t max_age_micros = 0;
+
+    // The number of threads that encode thread data. Above 1, the chunks of
+    // different threads are encoded into memory in parallel and then written
+    // out in order, so that saving many busy threads scales with cores at
+    // the cost of holding the encoded data in memory. Ignored on platforms
+    // without threads.
+    size_t parallelism = 1;
+
     // The open mode to use if a file is being opened. Defaults to trunc.
     // out is implied.
     std::ios_base::openmode open_mode =
         std::ios_base::trunc | std::ios_base::binary;
   };
 
+  // Receives the data of each save made by the streaming thread (see
+  // StartStreaming()), in order. Returns whether it was written successfully.
+  using StreamingSink = std::function<bool(const char* data, size_t length)>;
+
+  // Options controlling background streaming.
+  struct StreamingOptions {
+    static const StreamingOptions kDefault;
+
+    StreamingOptions() = default;
+
+    // Data is saved at least this often.
+    uint32_t interval_micros = 1000000;
+
+    // If non-zero, data is also saved as soon as the unsaved chunks across
+    // all thread buffers reach this many bytes (see
+    // Stats::unsaved_chunk_bytes). This is checked every kPollMicros.
+    size_t watermark_bytes = 0;
+
+    // How often the streaming thread checks the watermark (or stop request).
+    static constexpr uint32_t kPollMicros = 10000;
+  };
+
+  // Point in time statistics about the memory held by thread data.
+  struct Stats {
+    // The limit set by SetMemoryBudget() (0 if unlimited).
+    size_t memory_limit_bytes = 0;
+
+    // Bytes of event data currently allocated across all thread buffers.
+    size_t memory_used_bytes = 0;
+
+    // The number of thread and task buffers.
+    size_t thread_count = 0;
+
+    // Total events dropped because the memory budget was exhausted. Per
+    // buffer counts are available from EventBuffer::dropped_event_count()
+    // and are also recorded in saved traces as wtf.trace#dropped events.
+    size_t dropped_event_count = 0;
+
+    // Total chunks overwritten in flight recorder mode.
+    size_t discarded_chunk_count = 0;
+
+    // Bytes of filled chunks, across all thread buffers, that are waiting
+    // for a clearing save (see EventBuffer::unsaved_chunk_bytes()).
+    size_t unsaved_chunk_bytes = 0;
+
+    // Spare chunks kept from the buffers of exited threads for reuse by new
+    // ones.
+    size_t pooled_chunk_count = 0;
+  };
+
   // Gets the singleton instance.
   // Note that calling through to the instance is reserved for "heavy-weight"
   // operations. Logging events happens without involving this instance.
@@ -145,11 +255,41 @@ class Runtime {
   // obey all of the rules of writing to an EventBuffer, the most important
   // of which is to only write from one thread concurrently. You must also
   // make sure that any timestamps or event ids that you add are consistent
-  // with the overall system.
+  // with the overall system (i.e. get times from EventBuffer::GetEventTime()).
   EventBuffer* RegisterExternalThread(const char* thread_name,
                                       const char* type = nullptr,
                                       const char* location = nullptr);
 
+  // Sets the number of chunks to preallocate for each EventBuffer that is
+  // subsequently created for a thread or task. Preallocated chunks are drawn
+  // from before the writer touches the heap, and chunks released by clearing
+  // saves are recycled, so a thread that is streamed often enough will not
+  // allocate after it is enabled. Defaults to 0.
+  void SetPreallocatedChunkCount(size_t count);
+
+  // Sets a process wide limit on the bytes of event data held by all thread
+  // and task buffers, including preallocated chunks. Once it is reached,
+  // events that need a new chunk are dropped (cheaply) and counted per thread
+  // until saving with clear_thread_data frees up space. This does not affect
+  // memory that is already allocated. Defaults to 0 (unlimited).
+  void SetMemoryBudget(size_t limit_bytes);
+
+  // Gets current memory and drop statistics.
+  Stats GetStats();
+
+  // Puts each EventBuffer that is subsequently created for a thread or task
+  // into flight recorder mode, holding at most 'count' chunks. Once full, the
+  // oldest data is overwritten rather than allocating more memory. Combine
+  // with SetPreallocatedChunkCount(count) to avoid touching the heap at all
+  // while logging. Defaults to 0 (unbounded).
+  void SetFlightRecorderChunkCount(size_t count);
+
+  // Puts each EventBuffer that is subsequently created for a thread or task
+  // into compact encoding (see EventBuffer::SetCompactEncoding()), which
+  // typically cuts the memory and file size of scope heavy traces by 2-4x
+  // at the cost of a little CPU per event. Defaults to false.
+  void SetCompactEncoding(bool compact_encoding);
+
   // Disables WTF data collection for this thread. Note that any collected
   // data will still be present. This is largely intended for testing.
   void DisableCurrentThread();
@@ -168,6 +308,33 @@ class Runtime {
   bool SaveToFile(const std::string& file_name,
                   const SaveOptions& save_options = SaveOptions::kDefault);
 
+  // Starts a thread that repeatedly saves new data (as with
+  // SaveOptions::ForStreamingMulti()) and writes it to 'sink', as configured
+  // by 'options'. Only one stream can be active at a time, and the streaming
+  // thread itself is not traced. Other clearing saves made while streaming
+  // take their data out of the stream.
+  // Returns: Whether the thread was started. This fails if a stream is
+  // already active or the platform does not support threads.
+  bool StartStreaming(
+      StreamingSink sink,
+      const StreamingOptions& options = StreamingOptions::kDefault);
+
+  // Shortcut to StartStreaming(sink) that streams to a new file.
+  bool StartStreaming(
+      const std::string& file_name,
+      const StreamingOptions& options = StreamingOptions::kDefault);
+
+  // Makes a final save and stops the streaming thread. This no-ops if
+  // streaming is not active.
+  // Returns: Whether every save since StartStreaming() succeeded.
+  bool StopStreaming();
+
+  // Sinks for StartStreaming(). A file sink truncates the file, and returns
+  // an empty sink if it cannot be opened. A file descriptor sink does not
+  // take ownership of the descriptor.
+  static StreamingSink FileStreamingSink(const std::string& file_name);
+  static StreamingSink FdStreamingSink(int fd);
+
   // Asynchronously clears thread data. This is similar to passing
   // a clear_thread_data option to a Save() method, except that when doing it
   // at save time, only the saved data is cleared.
@@ -189,6 +356,13 @@ class Runtime {
     std::deque<EventBuffer*> idle_event_buffers;
   };
 
+  // Chunk ids 1 and 2 are taken by the file header and the event
+  // definitions, so thread EventBuffer ids start after them.
+  static constexpr uint32_t kFirstEventBufferId = 3;
+
+  // The most chunks kept from the buffers of exited threads.
+  static constexpr size_t kMaxPooledChunkCount = 256;
+
   Runtime();
   Runtime(const Runtime&) = delete;
   void operator=(const Runtime&) = delete;
@@ -197,10 +371,41 @@ class Runtime {
   // of owned instances.
   EventBuffer* CreateThreadEventBuffer();
 
+  // Copies the list of thread EventBuffers for use outside of mu_. The
+  // buffers stay alive until the matching ReleaseThreadEventBuffers().
+  std::vector<EventBuffer*> AcquireThreadEventBuffers();
+
+  // Ends an AcquireThreadEventBuffers(). Buffers in 'retired', whose threads
+  // had exited before their data was saved (or cleared), are removed. Once
+  // no other save is using them, they are destroyed, returning their chunks
+  // to the pool and their zones to the ZoneRegistry.
+  void ReleaseThreadEventBuffers(const std::vector<EventBuffer*>& retired);
+
+  // Body of the streaming thread.
+  void RunStreaming(StreamingSink sink, StreamingOptions options);
+
   platform::mutex mu_;
   std::vector<std::unique_ptr<EventBuffer>> thread_event_buffers_;
   std::unordered_map<std::string, TaskDefinition> tasks_;
   int uniquifier_ = 0;
+  uint32_t next_event_buffer_id_ = kFirstEventBufferId;
+  size_t preallocated_chunk_count_ = 0;
+  size_t flight_recorder_chunk_count_ = 0;
+  bool compact_encoding_ = false;
+  MemoryBudget memory_budget_;
+  EventBuffer::ChunkPool chunk_pool_{kMaxPooledChunkCount, &memory_budget_};
+
+  // The number of saves (or clears) using copies of thread_event_buffers_,
+  // and the buffers retired while any were.
+  int thread_event_buffer_readers_ = 0;
+  std::vector<std::unique_ptr<EventBuffer>> retired_event_buffers_;
+
+  // Streaming state. The thread is only started and joined while holding
+  // streaming_mu_, which is separate from mu_ since saves take that.
+  platform::mutex streaming_mu_;
+  std::unique_ptr<platform::thread> streaming_thread_;
+  platform::atomic<bool> streaming_stop_{false};
+  platform::atomic<bool> streaming_failed_{false};
 };
 
 // Represents a temporary assignment of an EventBuffer to a thread.
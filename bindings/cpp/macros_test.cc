@@ -14,6 +14,7 @@ namespace {
 class MacrosTest : public ::testing::Test {
  protected:
   void TearDown() override {
+    EventCategories::set_enabled(EventCategories::kAll);
     Runtime::GetInstance()->DisableCurrentThread();
     Runtime::GetInstance()->ResetForTesting();
   }
@@ -33,6 +34,12 @@ class MacrosTest : public ::testing::Test {
     return !event_buffer->empty();
   }
 
+  size_t PublishedBytes() {
+    OutputBuffer::PartHeader header;
+    PlatformGetThreadLocalEventBuffer()->PopulateHeader(&header);
+    return header.length;
+  }
+
   bool PrefixEventsHaveBeenLogged() {
     auto event_buffer = PlatformGetThreadLocalEventBuffer();
     if (!event_buffer) {
@@ -100,6 +107,9 @@ TEST_F(MacrosTest, EventsShouldBeDisabled) {
   WTF_EVENT("ShouldBeDisalbed#E1", int32_t)(0);
   { WTF_SCOPE0("ShouldBeDisabled#InnerLoop0"); }
   { WTF_SCOPE("ShouldBeDisabled#InnerLoop1", int32_t)(1); }
+  WTF_SAMPLED_EVENT(2, "ShouldBeDisabled#Sampled", int32_t)(0);
+  { WTF_COLLAPSIBLE_SCOPE0(1000, "ShouldBeDisabled#Collapsible"); }
+  { WTF_RATE_LIMITED_SCOPE0(2, "ShouldBeDisabled#RateLimited"); }
 
   {
     WTF_SCOPE0("ShouldBeDisabled#InnerLoop2");
@@ -173,6 +183,134 @@ TEST_F(MacrosTest, EventsShouldBeEnabled) {
   { WTF_SCOPE("ShouldBeEnabled#InnerLoop1", uint32_t)(1); }
   EXPECT_TRUE(EventsHaveBeenLogged());
   ClearEventBuffer();
+
+  WTF_EVENT("ShouldBeEnabled#Static: name", StaticString)
+  (WTF_STATIC_STRING("idle"));
+  EXPECT_TRUE(EventsHaveBeenLogged());
+  ClearEventBuffer();
+}
+
+TEST_F(MacrosTest, CategoriesCanBeDisabled) {
+  constexpr uint32_t kVerbose = 1 << 1;
+  WTF_THREAD_ENABLE_IF(true, "CategoriesCanBeDisabled");
+
+  EventCategories::set_enabled(EventCategories::kDefault);
+  WTF_CATEGORY_EVENT0(kVerbose, "Categories#E0");
+  WTF_CATEGORY_EVENT(kVerbose, "Categories#E1", int32_t)(1);
+  { WTF_CATEGORY_SCOPE0(kVerbose, "Categories#Scope0"); }
+  { WTF_CATEGORY_SCOPE(kVerbose, "Categories#Scope1", uint32_t)(1); }
+  EXPECT_FALSE(EventsHaveBeenLogged());
+
+  // Events without a category are in the default one.
+  WTF_EVENT0("Categories#Default");
+  EXPECT_TRUE(EventsHaveBeenLogged());
+  ClearEventBuffer();
+
+  EventCategories::set_enabled(EventCategories::kDefault | kVerbose);
+  EXPECT_TRUE(EventCategories::IsEnabled(kVerbose));
+  WTF_CATEGORY_EVENT0(kVerbose, "Categories#E0");
+  EXPECT_TRUE(EventsHaveBeenLogged());
+  ClearEventBuffer();
+
+  // Disabling the category of an open scope must still leave it.
+  WTF_EVENT0("Categories#Default");
+  OutputBuffer::PartHeader header;
+  PlatformGetThreadLocalEventBuffer()->PopulateHeader(&header);
+  uint32_t start_length = header.length;
+  {
+    WTF_CATEGORY_SCOPE0(kVerbose, "Categories#Open");
+    EventCategories::set_enabled(EventCategories::kDefault);
+  }
+  PlatformGetThreadLocalEventBuffer()->PopulateHeader(&header);
+  EXPECT_EQ(4 * sizeof(uint32_t), header.length - start_length);
+}
+
+TEST_F(MacrosTest, SampledEvents) {
+  WTF_THREAD_ENABLE_IF(true, "SampledEvents");
+  WTF_EVENT0("Sampled#Start");
+  size_t start_bytes = PublishedBytes();
+
+  // The first of every 4 is recorded. The second also reports the 3 skipped
+  // before it: [wire_id, time, wireId, count].
+  for (int i = 0; i < 8; i++) {
+    WTF_SAMPLED_EVENT(4, "Sampled#E1: i", int32_t)(i);
+  }
+  EXPECT_EQ(2 * 3 * sizeof(uint32_t) + 4 * sizeof(uint32_t),
+            PublishedBytes() - start_bytes);
+
+  // Balanced scopes are recorded for sampled invocations only.
+  start_bytes = PublishedBytes();
+  for (int i = 0; i < 3; i++) {
+    WTF_SAMPLED_SCOPE0(3, "Sampled#Scope0");
+  }
+  EXPECT_EQ(4 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+
+  // Disabled categories do not count towards the sample.
+  auto invoke = []() { WTF_SAMPLED_EVENT0(2, "Sampled#E0"); };
+  EventCategories::set_enabled(0);
+  invoke();
+  EventCategories::set_enabled(EventCategories::kAll);
+  start_bytes = PublishedBytes();
+  invoke();
+  EXPECT_EQ(2 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+}
+
+TEST_F(MacrosTest, RateLimitedEvents) {
+  WTF_THREAD_ENABLE_IF(true, "RateLimitedEvents");
+  WTF_EVENT0("RateLimited#Start");
+  size_t start_bytes = PublishedBytes();
+
+  for (int i = 0; i < 5; i++) {
+    WTF_RATE_LIMITED_EVENT0(2, "RateLimited#E0");
+  }
+  EXPECT_EQ(2 * 2 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+
+  start_bytes = PublishedBytes();
+  for (int i = 0; i < 5; i++) {
+    WTF_RATE_LIMITED_SCOPE(3, "RateLimited#Scope1: i", int32_t)(i);
+  }
+  EXPECT_EQ(3 * 5 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+}
+
+TEST_F(MacrosTest, CollapsibleScopes) {
+  constexpr uint32_t kSecond = 1000000000;
+  WTF_THREAD_ENABLE_IF(true, "CollapsibleScopes");
+  WTF_EVENT0("Collapsible#Start");
+  size_t start_bytes = PublishedBytes();
+
+  // Short scopes, including nested ones, leave nothing behind.
+  for (int i = 0; i < 3; i++) {
+    WTF_COLLAPSIBLE_SCOPE(kSecond, "Collapsible#Outer: i", int32_t)(i);
+    { WTF_COLLAPSIBLE_SCOPE0(kSecond, "Collapsible#Inner"); }
+  }
+  EXPECT_EQ(start_bytes, PublishedBytes());
+
+  // Scopes containing other events are kept: enter, event and leave.
+  {
+    WTF_COLLAPSIBLE_SCOPE0(kSecond, "Collapsible#Kept");
+    WTF_EVENT0("Collapsible#Nested");
+  }
+  EXPECT_EQ(3 * 2 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+
+  // As are ones that last long enough.
+  start_bytes = PublishedBytes();
+  { WTF_COLLAPSIBLE_SCOPE0(1, "Collapsible#Long"); }
+  EXPECT_EQ(2 * 2 * sizeof(uint32_t), PublishedBytes() - start_bytes);
+
+  // The next scope kept at a site reports how many were collapsed before it.
+  auto enter = [](bool nested) {
+    static ScopedEventEnabled<> event{"Collapsible#Report",
+                                      EventCategories::kDefault, kSecond};
+    AutoScopeEnabled<> scope{event};
+    scope.Enter();
+    if (nested) {
+      WTF_EVENT0("Collapsible#ReportNested");
+    }
+  };
+  enter(false);
+  start_bytes = PublishedBytes();
+  enter(true);
+  EXPECT_EQ((3 * 2 + 4) * sizeof(uint32_t), PublishedBytes() - start_bytes);
 }
 
 }  // namespace enabled
@@ -1,18 +1,38 @@
 #include "wtf/runtime.h"
 
+#include <unistd.h>
+
+#include <cerrno>
 #include <cstdint>
+#include <cstdlib>
 #include <fstream>
 #include <sstream>
+#include <streambuf>
+#include <unordered_set>
 
 namespace wtf {
 
 const Runtime::SaveOptions Runtime::SaveOptions::kDefault{};
+const Runtime::StreamingOptions Runtime::StreamingOptions::kDefault{};
 
 namespace {
 struct EventSnapshot {
   EventBuffer* event_buffer;
   OutputBuffer::PartHeader string_table_header;
   OutputBuffer::PartHeader event_buffer_header;
+  std::vector<OutputBuffer::PartHeader> resource_headers;
+
+  // If set, only the strings past the watermark are written, and the chunk
+  // takes the id of the EventBuffer. The watermark advances as written.
+  bool string_table_delta = false;
+  StringTable::Watermark string_table_watermark;
+
+  // Whether the chunk made it to the output.
+  bool written = false;
+
+  // Whether the thread had exited before the snapshot of a clearing save,
+  // which then holds all of its remaining data.
+  bool out_of_scope = false;
 };
 
 void WriteFileHeaderChunk(OutputBuffer* output_buffer) {
@@ -30,7 +50,8 @@ void WriteFileHeaderChunk(OutputBuffer* output_buffer) {
   json_stream << "{";
   json_stream << "\"type\": \"file_header\",";
   json_stream << "\"timebase\": 0,";  // We reset the platform to a 0 time base.
-  json_stream << "\"flags\": [\"has_high_resolution_times\"],";
+  json_stream << "\"flags\": [\"has_high_resolution_times\", "
+                 "\"has_nanosecond_times\"],";
   json_stream << "\"contextInfo\": {";
   json_stream << "\"contextType\": \"script\",";
   json_stream << "\"title\": \"C++ Trace\"";
@@ -56,32 +77,131 @@ void WriteFileHeaderChunk(OutputBuffer* output_buffer) {
   output_buffer->Align();
 }
 
-bool WriteEventChunk(OutputBuffer* output_buffer, EventSnapshot* snapshot,
-                     bool clear_event_buffer) {
-  // There will be two parts: string and event. The event part is actually
+// Returns the part headers of the event chunk for a snapshot.
+std::vector<OutputBuffer::PartHeader> EventChunkParts(
+    const EventSnapshot& snapshot) {
+  // There will be two parts, string and event, followed by any resources
+  // referenced by out of line array arguments. The event part is actually
   // a merged combination of the meta event + each thread event.
-  const size_t kPartCount = 2;
-  OutputBuffer::PartHeader part_headers[kPartCount] = {
-      snapshot->string_table_header,
-      snapshot->event_buffer_header,
+  std::vector<OutputBuffer::PartHeader> part_headers{
+      snapshot.string_table_header,
+      snapshot.event_buffer_header,
   };
+  part_headers.insert(part_headers.end(), snapshot.resource_headers.begin(),
+                      snapshot.resource_headers.end());
+  return part_headers;
+}
 
-  // Setup the chunk.
-  // TODO(laurenzo): Get timestamps from the EventBuffer based on what it
-  // has logged.
+bool WriteEventChunk(OutputBuffer* output_buffer, EventSnapshot* snapshot,
+                     bool clear_event_buffer) {
+  std::vector<OutputBuffer::PartHeader> part_headers =
+      EventChunkParts(*snapshot);
+
+  // Setup the chunk. Its times are in 32 bit micros, which wrap. Nothing
+  // depends on them, but keep them ordered if the range straddles a wrap.
+  uint32_t start_time = static_cast<uint32_t>(
+      snapshot->event_buffer->snapshot_start_time_nanos() / 1000);
+  uint32_t end_time = static_cast<uint32_t>(
+      snapshot->event_buffer->snapshot_end_time_nanos() / 1000);
+  if (start_time > end_time) {
+    start_time = 0;
+  }
+  uint32_t chunk_id =
+      snapshot->string_table_delta ? snapshot->event_buffer->id() : 2;
   OutputBuffer::ChunkHeader chunk_header{
-      2,                               // Id.
-      0x2,                             // Type = Events.
-      0,                               // Start time.
-      PlatformGetTimestampMicros32(),  // End time.
+      chunk_id,    // Id.
+      0x2,         // Type = Events.
+      start_time,  // Start time.
+      end_time,    // End time.
   };
-  output_buffer->StartChunk(chunk_header, part_headers, kPartCount);
+  output_buffer->StartChunk(chunk_header, part_headers.data(),
+                            part_headers.size());
+  StringTable* string_table = snapshot->event_buffer->string_table();
   bool success =
-      snapshot->event_buffer->string_table()->WriteTo(
-          &snapshot->string_table_header, output_buffer) &&
+      (snapshot->string_table_delta
+           ? string_table->WriteDeltaTo(&snapshot->string_table_header,
+                                        output_buffer,
+                                        &snapshot->string_table_watermark)
+           : string_table->WriteTo(&snapshot->string_table_header,
+                                   output_buffer)) &&
       snapshot->event_buffer->WriteTo(&snapshot->event_buffer_header,
-                                      output_buffer, clear_event_buffer);
+                                      output_buffer, clear_event_buffer) &&
+      snapshot->event_buffer->resource_table()->WriteTo(
+          snapshot->resource_headers, output_buffer);
+
+  snapshot->written = success;
+  return success;
+}
 
+// A streambuf over a fixed span of memory. Writing past the end fails.
+class SpanStreamBuf : public std::streambuf {
+ public:
+  SpanStreamBuf(char* data, size_t size) { setp(data, data + size); }
+  bool full() const { return pptr() == epptr(); }
+};
+
+// Writes the event chunk of each snapshot as with WriteEventChunk(), ending
+// their reads, but encodes them on up to 'parallelism' threads first. The
+// length of every chunk is known from its snapshot, so each is encoded
+// directly to its offset in a single block, which is then written in one go.
+bool WriteEventChunksInParallel(OutputBuffer* output_buffer,
+                                std::vector<EventSnapshot>* snapshots,
+                                bool clear_event_buffers,
+                                size_t parallelism) {
+  size_t count = snapshots->size();
+  std::vector<size_t> offsets(count + 1);
+  for (size_t i = 0; i < count; i++) {
+    auto part_headers = EventChunkParts((*snapshots)[i]);
+    offsets[i + 1] = offsets[i] + OutputBuffer::ChunkLength(
+                                      part_headers.data(), part_headers.size());
+  }
+  std::unique_ptr<char[]> data{new char[offsets[count]]};
+  std::unique_ptr<bool[]> results{new bool[count]};
+  platform::atomic<size_t> next_index{0};
+  auto encode = [&]() {
+    while (true) {
+      size_t i = next_index.fetch_add(1);
+      if (i >= count) {
+        break;
+      }
+      EventSnapshot* snapshot = &(*snapshots)[i];
+      SpanStreamBuf span{data.get() + offsets[i], offsets[i + 1] - offsets[i]};
+      std::ostream out{&span};
+      OutputBuffer chunk_buffer{&out};
+      results[i] =
+          WriteEventChunk(&chunk_buffer, snapshot, clear_event_buffers) &&
+          !out.fail() && span.full();
+      snapshot->event_buffer->EndRead();
+    }
+  };
+
+  // The calling thread is one of the workers.
+  std::vector<std::unique_ptr<platform::thread>> threads;
+  for (size_t i = 1; i < parallelism && i < count; i++) {
+    threads.emplace_back(new platform::thread(encode));
+  }
+  encode();
+  for (auto& thread : threads) {
+    thread->join();
+  }
+
+  // Write every chunk that encoded, in runs between failed ones. A clearing
+  // save has already cleared all of them, so nothing that encoded can be
+  // held back.
+  bool success = true;
+  size_t run_start = 0;
+  for (size_t i = 0; i <= count; i++) {
+    if (i < count && results[i]) {
+      continue;
+    }
+    output_buffer->Append(data.get() + offsets[run_start],
+                          offsets[i] - offsets[run_start]);
+    if (i < count) {
+      (*snapshots)[i].written = false;
+      success = false;
+    }
+    run_start = i + 1;
+  }
   return success;
 }
 
@@ -90,8 +210,21 @@ bool WriteEventChunk(OutputBuffer* output_buffer, EventSnapshot* snapshot,
 Runtime::Runtime() {
   PlatformInitializeThreading();
 
+  // Apply the initial category mask, if given.
+  const char* categories = std::getenv("WTF_CATEGORIES");
+  if (categories && *categories) {
+    char* end = nullptr;
+    unsigned long mask = std::strtoul(categories, &end, 0);
+    if (!*end) {
+      EventCategories::set_enabled(static_cast<uint32_t>(mask));
+    }
+  }
+
   // Force reference event types that we inline manually.
   StandardEvents::GetScopeLeaveEvent();
+  StandardEvents::GetDiscontinuityEvent();
+  StandardEvents::GetDroppedEventsEvent();
+  StandardEvents::GetTimebaseEvent();
 
   // Force registration of the create zone event (or else we race in saving,
   // not declaring it for the first time until after we have emitted
@@ -136,6 +269,7 @@ EventBuffer* Runtime::PopTaskEventBuffer(const std::string& name) {
   std::string unique_name = ss.str();
   int zone_id =
       ZoneRegistry::GetInstance()->CreateZone(unique_name.c_str(), "TASK", "");
+  created->set_zone_id(zone_id);
   StandardEvents::SetZone(created, zone_id);
   created->FreezePrefixSlots();
 
@@ -155,10 +289,51 @@ void Runtime::PushTaskEventBuffer(const std::string& name,
 
 EventBuffer* Runtime::CreateThreadEventBuffer() {
   EventBuffer* r;
-  thread_event_buffers_.emplace_back(r = new EventBuffer());
+  thread_event_buffers_.emplace_back(
+      r = new EventBuffer(EventBuffer::kDefaultChunkSizeBytes, &chunk_pool_));
+  r->set_id(next_event_buffer_id_++);
+  r->ReserveChunks(preallocated_chunk_count_);
+  r->SetMaximumChunkCount(flight_recorder_chunk_count_);
+  r->SetCompactEncoding(compact_encoding_);
   return r;
 }
 
+void Runtime::SetPreallocatedChunkCount(size_t count) {
+  platform::lock_guard<platform::mutex> lock{mu_};
+  preallocated_chunk_count_ = count;
+}
+
+void Runtime::SetMemoryBudget(size_t limit_bytes) {
+  memory_budget_.set_limit_bytes(limit_bytes);
+  chunk_pool_.Trim();
+}
+
+Runtime::Stats Runtime::GetStats() {
+  Stats stats;
+  stats.memory_limit_bytes = memory_budget_.limit_bytes();
+  stats.memory_used_bytes = memory_budget_.used_bytes();
+
+  platform::lock_guard<platform::mutex> lock{mu_};
+  stats.thread_count = thread_event_buffers_.size();
+  for (auto& event_buffer : thread_event_buffers_) {
+    stats.dropped_event_count += event_buffer->dropped_event_count();
+    stats.discarded_chunk_count += event_buffer->discarded_chunk_count();
+    stats.unsaved_chunk_bytes += event_buffer->unsaved_chunk_bytes();
+  }
+  stats.pooled_chunk_count = chunk_pool_.chunk_count();
+  return stats;
+}
+
+void Runtime::SetFlightRecorderChunkCount(size_t count) {
+  platform::lock_guard<platform::mutex> lock{mu_};
+  flight_recorder_chunk_count_ = count;
+}
+
+void Runtime::SetCompactEncoding(bool compact_encoding) {
+  platform::lock_guard<platform::mutex> lock{mu_};
+  compact_encoding_ = compact_encoding;
+}
+
 void Runtime::EnableCurrentThread(const char* thread_name, const char* type,
                                   const char* location) {
   if (PlatformGetThreadLocalEventBuffer()) {
@@ -186,6 +361,7 @@ EventBuffer* Runtime::RegisterExternalThread(const char* thread_name,
   std::string unique_name = ss.str();
   int zone_id = ZoneRegistry::GetInstance()->CreateZone(unique_name.c_str(),
                                                         type, location);
+  event_buffer->set_zone_id(zone_id);
   StandardEvents::SetZone(event_buffer, zone_id);
   event_buffer->FreezePrefixSlots();
   return event_buffer;
@@ -228,14 +404,8 @@ bool Runtime::Save(std::ostream* out, const SaveOptions& save_options) {
 
   // Make a copy of the thread event buffers in a lock. The rest can run
   // lock free.
-  std::vector<EventBuffer*> local_thread_event_buffers;
-  {
-    platform::lock_guard<platform::mutex> lock{mu_};
-    local_thread_event_buffers.reserve(thread_event_buffers_.size());
-    for (auto& event_buffer : thread_event_buffers_) {
-      local_thread_event_buffers.push_back(event_buffer.get());
-    }
-  }
+  std::vector<EventBuffer*> local_thread_event_buffers =
+      AcquireThreadEventBuffers();
 
   OutputBuffer output_buffer{out};
 
@@ -243,17 +413,37 @@ bool Runtime::Save(std::ostream* out, const SaveOptions& save_options) {
     WriteFileHeaderChunk(&output_buffer);
   }
 
-  // Accumulate headers for each thread.
+  // Accumulate headers for each thread. Each EventBuffer stays in read
+  // mode until it has been written so that flight recorder writers do not
+  // overwrite the snapshotted chunks.
   std::vector<EventSnapshot> thread_snapshots;
   thread_snapshots.resize(local_thread_event_buffers.size());
   for (size_t i = 0; i < local_thread_event_buffers.size(); i++) {
     auto& snapshot = thread_snapshots[i];
     snapshot.event_buffer = local_thread_event_buffers[i];
-    snapshot.event_buffer->PopulateHeader(&snapshot.event_buffer_header);
+    snapshot.out_of_scope = save_options.clear_thread_data &&
+                            snapshot.event_buffer->out_of_scope();
+    snapshot.event_buffer->BeginRead();
+    snapshot.event_buffer->PopulateHeader(&snapshot.event_buffer_header,
+                                          save_options.max_age_micros);
     // String table must be snapshotted after the EventBuffer so that it
-    // contains at least as many strings have been referenced.
-    snapshot.event_buffer->string_table()->PopulateHeader(
-        &snapshot.string_table_header);
+    // contains at least as many strings have been referenced. Checkpointed
+    // saves continue from what previous ones wrote.
+    StringTable* string_table = snapshot.event_buffer->string_table();
+    if (checkpoint) {
+      auto it = checkpoint->string_table_watermarks_.find(
+          snapshot.event_buffer->id());
+      if (it != checkpoint->string_table_watermarks_.end()) {
+        snapshot.string_table_watermark = it->second;
+      }
+      snapshot.string_table_delta = true;
+      string_table->PopulateDeltaHeader(&snapshot.string_table_header,
+                                        snapshot.string_table_watermark);
+    } else {
+      string_table->PopulateHeader(&snapshot.string_table_header);
+    }
+    snapshot.event_buffer->resource_table()->PopulateHeaders(
+        &snapshot.resource_headers);
   }
 
   // Populate the EventBuffer of event registrations. This is done after all
@@ -281,10 +471,10 @@ bool Runtime::Save(std::ostream* out, const SaveOptions& save_options) {
   }
 
   // Write new zone definitions.
-  size_t zone_definition_from_index =
-      checkpoint ? checkpoint->zone_definition_from_index_ : 0;
-  zone_definition_from_index = ZoneRegistry::GetInstance()->EmitZones(
-      &definition_buffer, zone_definition_from_index);
+  size_t zone_definition_from_sequence =
+      checkpoint ? checkpoint->zone_definition_from_sequence_ : 0;
+  zone_definition_from_sequence = ZoneRegistry::GetInstance()->EmitZones(
+      &definition_buffer, zone_definition_from_sequence);
 
   // Populate the header for the definition buffer.
   definition_buffer.PopulateHeader(&definition_snapshot.event_buffer_header);
@@ -293,42 +483,226 @@ bool Runtime::Save(std::ostream* out, const SaveOptions& save_options) {
 
   // Write the definition snapshot followed by each thread.
   bool success = WriteEventChunk(&output_buffer, &definition_snapshot, false);
-  for (auto& thread_snapshot : thread_snapshots) {
-    success = success && WriteEventChunk(&output_buffer, &thread_snapshot,
-                                         save_options.clear_thread_data);
+  if (platform::has_threads && save_options.parallelism > 1 &&
+      thread_snapshots.size() > 1) {
+    success = WriteEventChunksInParallel(&output_buffer, &thread_snapshots,
+                                         save_options.clear_thread_data,
+                                         save_options.parallelism) &&
+              success;
+  } else {
+    for (auto& thread_snapshot : thread_snapshots) {
+      success = success && WriteEventChunk(&output_buffer, &thread_snapshot,
+                                           save_options.clear_thread_data);
+      thread_snapshot.event_buffer->EndRead();
+    }
   }
 
   if (out->fail()) {
     success = false;
   }
 
-  // Advance the checkpoint, if available.
+  // Buffers of exited threads are released once their last data is out.
+  std::vector<EventBuffer*> retired;
+  if (!out->fail()) {
+    for (auto& thread_snapshot : thread_snapshots) {
+      if (thread_snapshot.out_of_scope && thread_snapshot.written) {
+        retired.push_back(thread_snapshot.event_buffer);
+      }
+    }
+  }
+
+  // Advance the checkpoint, if available. String tables advance for every
+  // chunk that was written, since a reader has seen those strings.
+  if (checkpoint && !out->fail()) {
+    auto& watermarks = checkpoint->string_table_watermarks_;
+    for (auto& thread_snapshot : thread_snapshots) {
+      if (thread_snapshot.written) {
+        watermarks[thread_snapshot.event_buffer->id()] =
+            thread_snapshot.string_table_watermark;
+      }
+    }
+    for (EventBuffer* event_buffer : retired) {
+      watermarks.erase(event_buffer->id());
+    }
+  }
   if (success && checkpoint) {
     checkpoint->event_definition_from_index_ =
         event_definition_from_index + event_definitions.size();
-    checkpoint->zone_definition_from_index_ = zone_definition_from_index;
+    checkpoint->zone_definition_from_sequence_ =
+        zone_definition_from_sequence;
   }
 
+  ReleaseThreadEventBuffers(retired);
   return success;
 }
 
+bool Runtime::StartStreaming(StreamingSink sink,
+                             const StreamingOptions& options) {
+  if (!platform::has_threads || !sink) {
+    return false;
+  }
+  platform::lock_guard<platform::mutex> lock{streaming_mu_};
+  if (streaming_thread_) {
+    return false;
+  }
+  streaming_stop_.store(false);
+  streaming_failed_.store(false);
+  streaming_thread_.reset(new platform::thread(
+      [this, sink, options]() { RunStreaming(sink, options); }));
+  return true;
+}
+
+bool Runtime::StartStreaming(const std::string& file_name,
+                             const StreamingOptions& options) {
+  return StartStreaming(FileStreamingSink(file_name), options);
+}
+
+bool Runtime::StopStreaming() {
+  platform::lock_guard<platform::mutex> lock{streaming_mu_};
+  if (!streaming_thread_) {
+    return true;
+  }
+  streaming_stop_.store(true);
+  streaming_thread_->join();
+  streaming_thread_.reset();
+  return !streaming_failed_.load();
+}
+
+Runtime::StreamingSink Runtime::FileStreamingSink(
+    const std::string& file_name) {
+  std::shared_ptr<std::ofstream> out{new std::ofstream(
+      file_name,
+      std::ios_base::out | std::ios_base::trunc | std::ios_base::binary)};
+  if (out->fail()) {
+    return nullptr;
+  }
+  return [out](const char* data, size_t length) {
+    out->write(data, length);
+    out->flush();
+    return !out->fail();
+  };
+}
+
+Runtime::StreamingSink Runtime::FdStreamingSink(int fd) {
+  return [fd](const char* data, size_t length) {
+    while (length) {
+      ssize_t written = ::write(fd, data, length);
+      if (written < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return false;
+      }
+      data += written;
+      length -= written;
+    }
+    return true;
+  };
+}
+
+void Runtime::RunStreaming(StreamingSink sink, StreamingOptions options) {
+  SaveCheckpoint checkpoint;
+  uint64_t interval_nanos =
+      static_cast<uint64_t>(options.interval_micros) * 1000;
+  uint64_t poll_micros = StreamingOptions::kPollMicros;
+  if (options.interval_micros < poll_micros) {
+    poll_micros = options.interval_micros;
+  }
+  uint64_t last_save_nanos = PlatformGetTimestampNanos64();
+  while (true) {
+    bool stopping = streaming_stop_.load();
+    uint64_t now = PlatformGetTimestampNanos64();
+    if (stopping || now - last_save_nanos >= interval_nanos ||
+        (options.watermark_bytes &&
+         GetStats().unsaved_chunk_bytes >= options.watermark_bytes)) {
+      // Saving to memory always advances the checkpoint, so if the sink
+      // fails, roll it back for the next save to repeat the definitions and
+      // string tables (and the file header, if none has been delivered).
+      // The events themselves are lost.
+      SaveCheckpoint previous_checkpoint = checkpoint;
+      std::ostringstream out;
+      bool success =
+          Save(&out, SaveOptions::ForStreamingMulti(&checkpoint));
+      std::string data = out.str();
+      if (!sink(data.data(), data.size())) {
+        checkpoint = previous_checkpoint;
+        success = false;
+      }
+      if (!success) {
+        streaming_failed_.store(true);
+      }
+      last_save_nanos = now;
+      if (stopping) {
+        break;
+      }
+    }
+    platform::sleep_for_micros(poll_micros);
+  }
+}
+
 void Runtime::ClearThreadData() {
   // Make a copy of the thread event buffers in a lock. The rest can run
   // lock free.
-  std::vector<EventBuffer*> local_thread_event_buffers;
-  {
-    platform::lock_guard<platform::mutex> lock{mu_};
-    local_thread_event_buffers.reserve(thread_event_buffers_.size());
-    for (auto& event_buffer : thread_event_buffers_) {
-      local_thread_event_buffers.push_back(event_buffer.get());
-    }
-  }
+  std::vector<EventBuffer*> local_thread_event_buffers =
+      AcquireThreadEventBuffers();
 
+  std::vector<EventBuffer*> retired;
   for (auto event_buffer : local_thread_event_buffers) {
+    bool out_of_scope = event_buffer->out_of_scope();
+
     // Do a dummy write and clear.
     OutputBuffer::PartHeader header;
+    std::vector<OutputBuffer::PartHeader> resource_headers;
+    event_buffer->BeginRead();
     event_buffer->PopulateHeader(&header);
+    event_buffer->resource_table()->PopulateHeaders(&resource_headers);
     event_buffer->WriteTo(&header, nullptr, true);
+    event_buffer->resource_table()->WriteTo(resource_headers, nullptr);
+    event_buffer->EndRead();
+    if (out_of_scope) {
+      retired.push_back(event_buffer);
+    }
+  }
+  ReleaseThreadEventBuffers(retired);
+}
+
+std::vector<EventBuffer*> Runtime::AcquireThreadEventBuffers() {
+  platform::lock_guard<platform::mutex> lock{mu_};
+  thread_event_buffer_readers_++;
+  std::vector<EventBuffer*> local_thread_event_buffers;
+  local_thread_event_buffers.reserve(thread_event_buffers_.size());
+  for (auto& event_buffer : thread_event_buffers_) {
+    local_thread_event_buffers.push_back(event_buffer.get());
+  }
+  return local_thread_event_buffers;
+}
+
+void Runtime::ReleaseThreadEventBuffers(
+    const std::vector<EventBuffer*>& retired) {
+  std::vector<std::unique_ptr<EventBuffer>> destroyed;
+  {
+    platform::lock_guard<platform::mutex> lock{mu_};
+    if (!retired.empty()) {
+      std::unordered_set<EventBuffer*> retired_set{retired.begin(),
+                                                   retired.end()};
+      size_t kept_count = 0;
+      for (auto& event_buffer : thread_event_buffers_) {
+        if (retired_set.count(event_buffer.get())) {
+          retired_event_buffers_.push_back(std::move(event_buffer));
+        } else {
+          thread_event_buffers_[kept_count++] = std::move(event_buffer);
+        }
+      }
+      thread_event_buffers_.resize(kept_count);
+    }
+    if (--thread_event_buffer_readers_ == 0) {
+      destroyed.swap(retired_event_buffers_);
+    }
+  }
+
+  // No save can see these any more.
+  for (auto& event_buffer : destroyed) {
+    ZoneRegistry::GetInstance()->ReleaseZone(event_buffer->zone_id());
   }
 }
 
@@ -1,6 +1,8 @@
 #include "wtf/runtime.h"
 
+#include <cstring>
 #include <fstream>
+#include <sstream>
 
 #include "gtest/gtest.h"
 
@@ -19,6 +21,21 @@ class RuntimeTest : public ::testing::Test {
   }
 };
 
+// Tests that the platform clock (whichever is configured) advances in step
+// with real time.
+TEST_F(RuntimeTest, TimestampsTrackRealTime) {
+  Runtime::GetInstance();
+  uint32_t start = PlatformGetTimestampMicros32();
+  uint64_t start_nanos = PlatformGetTimestampNanos64();
+  usleep(20000);
+  uint32_t elapsed = PlatformGetTimestampMicros32() - start;
+  uint64_t elapsed_nanos = PlatformGetTimestampNanos64() - start_nanos;
+  EXPECT_LE(20000u, elapsed);
+  EXPECT_GT(1000000u, elapsed);
+  EXPECT_LE(20000000u, elapsed_nanos);
+  EXPECT_GT(1000000000u, elapsed_nanos);
+}
+
 TEST_F(RuntimeTest, BasicEndToEnd) {
   Runtime::GetInstance()->EnableCurrentThread("TestThread");
   Event<uint32_t, uint16_t> event1{"foo#bar: a, b"};
@@ -74,6 +91,434 @@ TEST_F(RuntimeTest, SaveAndClear) {
       Runtime::SaveOptions::ForClear()));
 }
 
+// Tests that the streaming thread saves data through its sink until stopped.
+TEST_F(RuntimeTest, Streaming) {
+  auto runtime = Runtime::GetInstance();
+  std::string streamed;
+  auto sink = [&streamed](const char* data, size_t length) {
+    streamed.append(data, length);
+    return true;
+  };
+  Runtime::StreamingOptions options;
+  options.interval_micros = 1000;
+  if (!platform::has_threads) {
+    EXPECT_FALSE(runtime->StartStreaming(sink, options));
+    return;
+  }
+  ASSERT_TRUE(runtime->StartStreaming(sink, options));
+  EXPECT_FALSE(runtime->StartStreaming(sink, options));
+
+  runtime->EnableCurrentThread("TestThread");
+  Event<uint32_t> event{"Streaming#event: i"};
+  for (uint32_t i = 0; i < 100; i++) {
+    event.Invoke(i);
+    usleep(100);
+  }
+  EXPECT_TRUE(runtime->StopStreaming());
+  EXPECT_TRUE(runtime->StopStreaming());
+
+  // The stream is a single trace file: one header, then each save's chunks.
+  ASSERT_LE(4u, streamed.size());
+  uint32_t magic;
+  memcpy(&magic, streamed.data(), sizeof(magic));
+  EXPECT_EQ(0xdeadbeef, magic);
+  EXPECT_EQ(std::string::npos, streamed.find("\xef\xbe\xad\xde", 4));
+  EXPECT_EQ(0u, runtime->GetStats().unsaved_chunk_bytes);
+
+  // A file sink can be used again afterwards.
+  ASSERT_TRUE(
+      runtime->StartStreaming(TMP_PREFIX "tmptestbuf_streaming.wtf-trace"));
+  event.Invoke(1);
+  EXPECT_TRUE(runtime->StopStreaming());
+  std::ifstream in{TMP_PREFIX "tmptestbuf_streaming.wtf-trace",
+                   std::ios_base::binary};
+  EXPECT_TRUE(in.good());
+  EXPECT_FALSE(Runtime::FileStreamingSink("/nonexistent/dir/file"));
+}
+
+// Tests that a save whose sink write fails is repeated in full by the next.
+TEST_F(RuntimeTest, StreamingSinkFailure) {
+  auto runtime = Runtime::GetInstance();
+  runtime->EnableCurrentThread("TestThread");
+  Event<uint32_t> event{"StreamingSinkFailure#event: i"};
+  event.Invoke(1);
+
+  std::string streamed;
+  int sink_call_count = 0;
+  auto sink = [&](const char* data, size_t length) {
+    if (!sink_call_count++) {
+      return false;
+    }
+    streamed.append(data, length);
+    return true;
+  };
+  Runtime::StreamingOptions options;
+  options.interval_micros = 1000;
+  if (!platform::has_threads) {
+    return;
+  }
+  ASSERT_TRUE(runtime->StartStreaming(sink, options));
+  for (uint32_t i = 0; i < 20; i++) {
+    event.Invoke(i);
+    usleep(1000);
+  }
+  EXPECT_FALSE(runtime->StopStreaming());
+
+  // The delivered stream still starts with the file header and defines the
+  // event.
+  EXPECT_LE(2, sink_call_count);
+  ASSERT_LE(4u, streamed.size());
+  uint32_t magic;
+  memcpy(&magic, streamed.data(), sizeof(magic));
+  EXPECT_EQ(0xdeadbeef, magic);
+  EXPECT_NE(std::string::npos, streamed.find("StreamingSinkFailure#event"));
+}
+
+// Tests that the streaming thread saves early once unsaved data reaches the
+// watermark.
+TEST_F(RuntimeTest, StreamingWatermark) {
+  if (!platform::has_threads) {
+    return;
+  }
+  auto runtime = Runtime::GetInstance();
+  platform::atomic<int> save_count{0};
+  Runtime::StreamingOptions options;
+  options.interval_micros = 3600u * 1000000;
+  options.watermark_bytes = 1;
+  ASSERT_TRUE(runtime->StartStreaming(
+      [&save_count](const char*, size_t) {
+        save_count.fetch_add(1);
+        return true;
+      },
+      options));
+
+  // Fill a couple of chunks and wait for a save to release them.
+  runtime->EnableCurrentThread("TestThread");
+  Event<uint32_t, uint32_t> event{"StreamingWatermark#event: a, b"};
+  for (uint32_t i = 0; i < 5000; i++) {
+    event.Invoke(i, i);
+  }
+  for (int i = 0; i < 1000 && runtime->GetStats().unsaved_chunk_bytes; i++) {
+    usleep(1000);
+  }
+  EXPECT_EQ(0u, runtime->GetStats().unsaved_chunk_bytes);
+  EXPECT_TRUE(runtime->StopStreaming());
+  EXPECT_LE(2, save_count.load());
+}
+
+// Tests that checkpointed saves only write the strings added since the last
+// one.
+TEST_F(RuntimeTest, StringTableDeltas) {
+  auto runtime = Runtime::GetInstance();
+  EventBuffer* event_buffer = runtime->RegisterExternalThread("Deltas");
+  EventEnabled<const char*> event{"StringTableDeltas#event: s"};
+  Runtime::SaveCheckpoint checkpoint;
+  auto save = [runtime, &checkpoint]() {
+    std::ostringstream out;
+    EXPECT_TRUE(runtime->Save(
+        &out, Runtime::SaveOptions::ForStreamingMulti(&checkpoint)));
+    return out.str();
+  };
+
+  event.InvokeSpecific(event_buffer, "FirstString");
+  std::string first = save();
+  EXPECT_NE(std::string::npos, first.find("FirstString"));
+  EXPECT_NE(std::string::npos, first.find(":Deltas"));
+
+  event.InvokeSpecific(event_buffer, "FirstString");
+  event.InvokeSpecific(event_buffer, "SecondString");
+  std::string second = save();
+  EXPECT_EQ(std::string::npos, second.find("FirstString"));
+  EXPECT_EQ(std::string::npos, second.find(":Deltas"));
+  EXPECT_NE(std::string::npos, second.find("SecondString"));
+
+  // Saves without a checkpoint still write whole tables.
+  std::ostringstream out;
+  EXPECT_TRUE(runtime->Save(&out));
+  EXPECT_NE(std::string::npos, out.str().find("FirstString"));
+  EXPECT_NE(std::string::npos, out.str().find("SecondString"));
+}
+
+// Tests that a thread can keep interning strings and recording events while
+// a save of its buffer is stalled writing to the stream.
+TEST_F(RuntimeTest, SaveDoesNotBlockWriters) {
+  if (!platform::has_threads) {
+    return;
+  }
+  // Stalls the write of the given string until released. This is in the
+  // middle of writing the thread's string table.
+  class StalledStreamBuf : public std::streambuf {
+   public:
+    explicit StalledStreamBuf(const char* stall_at) : stall_at_{stall_at} {}
+    platform::atomic<bool> stalled{false};
+    platform::atomic<bool> released{false};
+
+   protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+      if (std::string(s, n).find(stall_at_) != std::string::npos) {
+        stalled.store(true);
+        while (!released.load()) {
+          usleep(100);
+        }
+      }
+      return n;
+    }
+
+   private:
+    const char* stall_at_;
+  };
+
+  auto runtime = Runtime::GetInstance();
+  EventBuffer* event_buffer = runtime->RegisterExternalThread("Writer");
+  EventEnabled<const char*> event{"SaveDoesNotBlockWriters#event: s"};
+  event.InvokeSpecific(event_buffer, "Before");
+
+  StalledStreamBuf stalled_buf{"Before"};
+  platform::atomic<bool> saved{false};
+  platform::thread save_thread{[&]() {
+    std::ostream out{&stalled_buf};
+    EXPECT_TRUE(runtime->Save(&out));
+    saved.store(true);
+  }};
+  while (!stalled_buf.stalled.load()) {
+    usleep(100);
+  }
+  for (int i = 0; i < 1000; i++) {
+    event.InvokeSpecific(event_buffer, ("During" + std::to_string(i)).c_str());
+  }
+  EXPECT_FALSE(saved.load());
+  stalled_buf.released.store(true);
+  save_thread.join();
+
+  std::ostringstream out;
+  EXPECT_TRUE(runtime->Save(&out));
+  EXPECT_NE(std::string::npos, out.str().find("During999"));
+}
+
+// Tests that a thread's buffer is saved one last time after it exits and is
+// then reclaimed, with its chunks pooled and its zone reused.
+TEST_F(RuntimeTest, ReclaimExitedThreads) {
+  if (!platform::has_threads) {
+    return;
+  }
+  auto runtime = Runtime::GetInstance();
+  static Event<const char*> event{"#ReclaimExitedThreads: s"};
+  auto run_thread = [&](const char* name) {
+    int zone_id = 0;
+    platform::thread thread{[&]() {
+      runtime->EnableCurrentThread(name);
+      zone_id = PlatformGetThreadLocalEventBuffer()->zone_id();
+      event.Invoke(name);
+    }};
+    thread.join();
+    return zone_id;
+  };
+
+  int zone_id = run_thread("ExitedThread1");
+  EXPECT_EQ(1u, runtime->GetStats().thread_count);
+  std::ostringstream out;
+  EXPECT_TRUE(runtime->Save(&out, Runtime::SaveOptions::ForClear()));
+  EXPECT_NE(std::string::npos, out.str().find("ExitedThread1"));
+  auto stats = runtime->GetStats();
+  EXPECT_EQ(0u, stats.thread_count);
+  EXPECT_LT(0u, stats.pooled_chunk_count);
+
+  // The next thread takes the pooled chunks and the released zone.
+  EXPECT_EQ(zone_id, run_thread("ExitedThread2"));
+  EXPECT_GT(stats.pooled_chunk_count, runtime->GetStats().pooled_chunk_count);
+  std::ostringstream second_out;
+  EXPECT_TRUE(runtime->Save(&second_out));
+  EXPECT_NE(std::string::npos, second_out.str().find("ExitedThread2"));
+  EXPECT_EQ(std::string::npos, second_out.str().find("ExitedThread1"));
+}
+
+// Tests that encoding threads in parallel produces the same file as saving
+// them one at a time.
+TEST_F(RuntimeTest, ParallelSave) {
+  auto runtime = Runtime::GetInstance();
+  EventEnabled<uint32_t, uint32_t> event{"ParallelSave#event: a, b"};
+  for (uint32_t i = 0; i < 8; i++) {
+    EventBuffer* event_buffer = runtime->RegisterExternalThread("Parallel");
+    for (uint32_t j = 0; j < 1000 * i; j++) {
+      event.InvokeSpecific(event_buffer, i, j);
+    }
+  }
+
+  // Returns the thread chunks of a save. The file header and definition
+  // chunks are skipped and chunk times, which can be the time of the
+  // snapshot, are masked out.
+  auto save = [runtime](size_t parallelism) {
+    Runtime::SaveOptions options;
+    options.parallelism = parallelism;
+    std::ostringstream out;
+    EXPECT_TRUE(runtime->Save(&out, options));
+    std::string data = out.str();
+    size_t thread_chunks_offset = 0;
+    int chunk_index = 0;
+    for (size_t offset = 3 * sizeof(uint32_t); offset + 24 <= data.size();
+         chunk_index++) {
+      uint32_t chunk_length;
+      memcpy(&chunk_length, &data[offset + 8], sizeof(chunk_length));
+      memset(&data[offset + 12], 0, 2 * sizeof(uint32_t));
+      EXPECT_LT(0u, chunk_length);
+      offset += chunk_length;
+      if (chunk_index == 1) {
+        thread_chunks_offset = offset;
+      }
+    }
+    return data.substr(thread_chunks_offset);
+  };
+  std::string serial = save(1);
+  EXPECT_EQ(serial, save(4));
+  EXPECT_EQ(serial, save(100));
+
+  Runtime::SaveOptions options = Runtime::SaveOptions::ForClear();
+  options.parallelism = 3;
+  std::ostringstream out;
+  EXPECT_TRUE(runtime->Save(&out, options));
+  EXPECT_EQ(0u, runtime->GetStats().unsaved_chunk_bytes);
+  EXPECT_GT(serial.size(), save(4).size());
+}
+
+// Tests that a flight recorder thread stays bounded and that saving it notes
+// the lost data.
+TEST_F(RuntimeTest, FlightRecorder) {
+  const size_t kChunkCount = 4;
+  Runtime::GetInstance()->SetFlightRecorderChunkCount(kChunkCount);
+  Runtime::GetInstance()->EnableCurrentThread("TestThread");
+  Runtime::GetInstance()->SetFlightRecorderChunkCount(0);
+  static Event<uint32_t, uint32_t> event1{"#FlightEvent: a, b"};
+
+  // Log far more than the recorder can hold.
+  for (size_t i = 0; i < 100000; i++) {
+    event1.Invoke(3, i);
+  }
+  EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
+  EXPECT_LT(0u, event_buffer->discarded_chunk_count());
+  OutputBuffer::PartHeader header;
+  event_buffer->PopulateHeader(&header);
+  EXPECT_GE(kChunkCount * EventBuffer::kDefaultChunkSizeBytes, header.length);
+
+  std::stringstream out;
+  EXPECT_TRUE(
+      Runtime::GetInstance()->Save(&out, Runtime::SaveOptions::ForClear()));
+  EXPECT_NE(std::string::npos, out.str().find("wtf.trace#discontinuity"));
+}
+
+// Tests that thread buffers stop growing at the memory budget and that the
+// drops are reported.
+TEST_F(RuntimeTest, MemoryBudget) {
+  const size_t kLimitBytes = 4 * EventBuffer::kDefaultChunkSizeBytes;
+  Runtime::GetInstance()->SetMemoryBudget(kLimitBytes);
+  Runtime::GetInstance()->EnableCurrentThread("TestThread");
+  static Event<uint32_t, uint32_t> event1{"#BudgetEvent: a, b"};
+
+  for (size_t i = 0; i < 100000; i++) {
+    event1.Invoke(3, i);
+  }
+  auto stats = Runtime::GetInstance()->GetStats();
+  EXPECT_EQ(kLimitBytes, stats.memory_limit_bytes);
+  EXPECT_GE(kLimitBytes, stats.memory_used_bytes);
+  EXPECT_EQ(1u, stats.thread_count);
+  EXPECT_LT(0u, stats.dropped_event_count);
+  EXPECT_EQ(stats.dropped_event_count,
+            PlatformGetThreadLocalEventBuffer()->dropped_event_count());
+
+  std::stringstream out;
+  EXPECT_TRUE(
+      Runtime::GetInstance()->Save(&out, Runtime::SaveOptions::ForClear()));
+  EXPECT_NE(std::string::npos, out.str().find("wtf.trace#dropped"));
+  Runtime::GetInstance()->SetMemoryBudget(0);
+}
+
+// Tests that compactly encoded threads save (including lost data markers)
+// and take far less space than the slot encoding.
+TEST_F(RuntimeTest, CompactEncoding) {
+  const size_t kChunkCount = 4;
+  Runtime::GetInstance()->SetCompactEncoding(true);
+  Runtime::GetInstance()->SetFlightRecorderChunkCount(kChunkCount);
+  Runtime::GetInstance()->EnableCurrentThread("TestThread");
+  Runtime::GetInstance()->SetFlightRecorderChunkCount(0);
+  Runtime::GetInstance()->SetCompactEncoding(false);
+  static ScopedEvent<uint32_t> s{"#CompactScope: iteration"};
+
+  EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
+  EXPECT_TRUE(event_buffer->compact_encoding());
+  for (size_t i = 0; i < 1000; i++) {
+    s.Enter(i & 0xff);
+    s.Leave();
+  }
+  OutputBuffer::PartHeader header;
+  event_buffer->PopulateHeader(&header);
+  EXPECT_EQ(0x20003u, header.type);
+  EXPECT_GT(1000u * 5 * sizeof(uint32_t) / 2, header.length);
+
+  // Overflow the recorder.
+  for (size_t i = 0; i < 100000; i++) {
+    s.Enter(i);
+    s.Leave();
+  }
+  EXPECT_LT(0u, event_buffer->discarded_chunk_count());
+  std::stringstream out;
+  EXPECT_TRUE(
+      Runtime::GetInstance()->Save(&out, Runtime::SaveOptions::ForClear()));
+  EXPECT_NE(std::string::npos, out.str().find("wtf.trace#discontinuity"));
+}
+
+// Tests that small arrays are stored inline and large ones as resources.
+TEST_F(RuntimeTest, ArrayArguments) {
+  Runtime::GetInstance()->EnableCurrentThread("TestThread");
+  static Event<Array<uint32_t>, Blob> event{"#Arrays: histogram, payload"};
+  EventBuffer* event_buffer = PlatformGetThreadLocalEventBuffer();
+
+  const uint32_t histogram[] = {1, 2, 3, 4};
+  std::string payload(EventBuffer::kMaximumInlineArraySlotCount * 4 + 1, 'x');
+  event.Invoke(Array<uint32_t>{histogram, 4},
+               Blob{payload.data(), payload.size()});
+  event.Invoke(Array<uint32_t>{histogram, 2}, Blob{"abc", 3});
+
+  std::vector<OutputBuffer::PartHeader> headers;
+  event_buffer->resource_table()->PopulateHeaders(&headers);
+  ASSERT_EQ(1u, headers.size());
+  EXPECT_EQ(0x40000u, headers[0].type);
+  EXPECT_EQ(payload.size(), headers[0].length);
+
+  // The saved file holds the payload, once, after the thread's events.
+  std::stringstream out;
+  EXPECT_TRUE(Runtime::GetInstance()->Save(&out));
+  std::string saved = out.str();
+  size_t payload_offset = saved.find(payload);
+  ASSERT_NE(std::string::npos, payload_offset);
+  EXPECT_EQ(std::string::npos, saved.find(payload, payload_offset + 1));
+  EXPECT_EQ(0u, payload_offset % 4);
+}
+
+// Tests that clearing saves free the resources they have written, so that
+// later saves and memory use do not keep growing.
+TEST_F(RuntimeTest, ArrayArgumentsAreReleased) {
+  Runtime::GetInstance()->EnableCurrentThread("TestThread");
+  static Event<Blob> event{"#ReleasedArrays: payload"};
+  std::string first(EventBuffer::kMaximumInlineArraySlotCount * 4 + 1, 'a');
+  std::string second(first.size(), 'b');
+
+  event.Invoke(Blob{first.data(), first.size()});
+  size_t used_bytes = Runtime::GetInstance()->GetStats().memory_used_bytes;
+  std::stringstream out;
+  EXPECT_TRUE(
+      Runtime::GetInstance()->Save(&out, Runtime::SaveOptions::ForClear()));
+  EXPECT_NE(std::string::npos, out.str().find(first));
+  EXPECT_EQ(used_bytes - first.size(),
+            Runtime::GetInstance()->GetStats().memory_used_bytes);
+
+  event.Invoke(Blob{second.data(), second.size()});
+  std::stringstream second_out;
+  EXPECT_TRUE(Runtime::GetInstance()->Save(&second_out,
+                                           Runtime::SaveOptions::ForClear()));
+  EXPECT_EQ(std::string::npos, second_out.str().find(first));
+  EXPECT_NE(std::string::npos, second_out.str().find(second));
+}
+
 }  // namespace
 }  // namespace wtf
 
@@ -0,0 +1,178 @@
+// Save-path throughput benchmark.
+//
+// Fills a number of EventBuffers (registered as external threads) with a
+// large amount of synthetic event data and times Runtime::Save and
+// Runtime::SaveToFile in the full, ForClear and ForStreamingFile modes, both
+// serially and encoding kSaveParallelism buffers at a time. Each result is
+// reported in MB/s of trace output.
+//
+// Usage:
+//   ./save_bench [total_mb] [buffer_count]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "wtf/runtime.h"
+
+#ifndef TMP_PREFIX
+#define TMP_PREFIX ""
+#endif
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kStreamingRounds = 3;
+constexpr size_t kSaveParallelism = 4;
+const char kFileName[] = TMP_PREFIX "tmp_save_bench.wtf-trace";
+
+// Counts and discards everything written to it.
+class CountingStreamBuf : public std::streambuf {
+ public:
+  size_t count() const { return count_; }
+
+ protected:
+  int overflow(int c) override {
+    count_ += 1;
+    return c;
+  }
+  std::streamsize xsputn(const char*, std::streamsize n) override {
+    count_ += n;
+    return n;
+  }
+
+ private:
+  size_t count_ = 0;
+};
+
+size_t FileSize(const char* file_name) {
+  std::ifstream in(file_name, std::ios_base::binary | std::ios_base::ate);
+  return in ? static_cast<size_t>(in.tellg()) : 0;
+}
+
+// Returns the options with parallel encoding of buffers enabled.
+wtf::Runtime::SaveOptions Parallel(wtf::Runtime::SaveOptions save_options) {
+  save_options.parallelism = kSaveParallelism;
+  return save_options;
+}
+
+class SaveBench {
+ public:
+  SaveBench(size_t total_bytes, int buffer_count) {
+    // Each event is a wire id, timestamp and two argument slots.
+    events_per_buffer_ = total_bytes / buffer_count / (4 * sizeof(uint32_t));
+    for (int i = 0; i < buffer_count; i++) {
+      buffers_.push_back(
+          wtf::Runtime::GetInstance()->RegisterExternalThread("SaveBench"));
+    }
+  }
+
+  // Appends events_per_buffer_ events to every buffer.
+  void Fill() {
+    static wtf::EventEnabled<int32_t, int32_t> event{"SaveBench#Event: a, b"};
+    for (auto* event_buffer : buffers_) {
+      for (size_t i = 0; i < events_per_buffer_; i++) {
+        event.InvokeSpecific(event_buffer, i, 0);
+      }
+    }
+  }
+
+  // Times a single call to Save() against a counting stream.
+  bool TimeSave(const char* name,
+                const wtf::Runtime::SaveOptions& save_options) {
+    CountingStreamBuf counting_buf;
+    std::ostream out(&counting_buf);
+    auto start = Clock::now();
+    bool success = wtf::Runtime::GetInstance()->Save(&out, save_options);
+    Report(name, counting_buf.count(), start);
+    return success;
+  }
+
+  // Times a single call to SaveToFile().
+  bool TimeSaveToFile(const char* name,
+                      const wtf::Runtime::SaveOptions& save_options) {
+    size_t start_size = FileSize(kFileName);
+    auto start = Clock::now();
+    bool success =
+        wtf::Runtime::GetInstance()->SaveToFile(kFileName, save_options);
+    size_t end_size = FileSize(kFileName);
+    Report(name, end_size > start_size ? end_size - start_size : end_size,
+           start);
+    return success;
+  }
+
+ private:
+  void Report(const char* name, size_t bytes, Clock::time_point start) {
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+    double mb = bytes / (1024.0 * 1024.0);
+    std::printf("%-36s %10.1f MB %10.3f s %10.1f MB/s\n", name, mb, seconds,
+                mb / seconds);
+    std::fflush(stdout);
+  }
+
+  size_t events_per_buffer_;
+  std::vector<wtf::EventBuffer*> buffers_;
+};
+
+}  // namespace
+
+extern "C" int main(int argc, char** argv) {
+  size_t total_mb = 256;
+  int buffer_count = 16;
+  if (argc > 1) {
+    total_mb = std::strtoul(argv[1], nullptr, 10);
+  }
+  if (argc > 2) {
+    buffer_count = std::atoi(argv[2]);
+  }
+  if (total_mb == 0 || buffer_count < 1) {
+    std::fprintf(stderr, "Usage: %s [total_mb] [buffer_count]\n", argv[0]);
+    return 1;
+  }
+
+  std::printf("Saving %zu MB of events across %d buffers.\n", total_mb,
+              buffer_count);
+  SaveBench bench(total_mb * 1024 * 1024, buffer_count);
+  bool success = true;
+  std::remove(kFileName);
+
+  // Full saves leave the data in place, so one fill serves both.
+  bench.Fill();
+  success &= bench.TimeSave("Save (full)", wtf::Runtime::SaveOptions());
+  success &= bench.TimeSave("Save (full, parallel)",
+                            Parallel(wtf::Runtime::SaveOptions()));
+  success &=
+      bench.TimeSaveToFile("SaveToFile (full)", wtf::Runtime::SaveOptions());
+
+  success &= bench.TimeSave("Save (ForClear)",
+                            wtf::Runtime::SaveOptions::ForClear());
+  bench.Fill();
+  success &= bench.TimeSaveToFile("SaveToFile (ForClear)",
+                                  wtf::Runtime::SaveOptions::ForClear());
+  bench.Fill();
+  success &= bench.TimeSaveToFile(
+      "SaveToFile (ForClear, parallel)",
+      Parallel(wtf::Runtime::SaveOptions::ForClear()));
+
+  std::remove(kFileName);
+  wtf::Runtime::SaveCheckpoint checkpoint;
+  for (int i = 0; i < kStreamingRounds; i++) {
+    bench.Fill();
+    success &= bench.TimeSaveToFile(
+        "SaveToFile (ForStreamingFile)",
+        wtf::Runtime::SaveOptions::ForStreamingFile(&checkpoint));
+  }
+  std::remove(kFileName);
+
+  if (!success) {
+    std::fprintf(stderr, "Error was reported!\n");
+    return 1;
+  }
+  return 0;
+}
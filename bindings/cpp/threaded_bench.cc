@@ -0,0 +1,215 @@
+// Multi-thread scalability benchmark.
+//
+// Modeled on threaded_torture_test, but instead of checking for errors, this
+// sweeps from 1 to N writer threads (doubling each step) with a concurrent
+// thread repeatedly calling Runtime::Save. For each step it reports aggregate
+// events/sec, sampled per-event latency percentiles, and how long saves take
+// along with the writer latency observed while a save was in progress.
+//
+// Usage:
+//   ./threaded_bench [max_threads] [seconds_per_step]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "wtf/macros.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Time one in every kSampleInterval events so that timing overhead does not
+// dominate the throughput numbers.
+constexpr uint64_t kSampleInterval = 64;
+
+std::atomic<bool> stop;
+std::atomic<bool> save_in_progress;
+
+// Discards everything written to it.
+class NullStreamBuf : public std::streambuf {
+ protected:
+  int overflow(int c) override { return c; }
+  std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+struct WriterStats {
+  uint64_t event_count = 0;
+  std::vector<uint32_t> latencies_ns;
+  std::vector<uint32_t> save_latencies_ns;
+};
+
+struct SaverStats {
+  uint64_t save_count = 0;
+  double total_save_ms = 0;
+  double max_save_ms = 0;
+};
+
+uint32_t ElapsedNanos(Clock::time_point start) {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                 start);
+  return static_cast<uint32_t>(std::min<int64_t>(ns.count(), UINT32_MAX));
+}
+
+void Writer(int thread_number, WriterStats* stats) {
+  WTF_THREAD_ENABLE("Writer");
+  static wtf::EventEnabled<int32_t, int32_t> event{
+      "ThreadedBench#Event: thread_number, i"};
+  static wtf::EventEnabled<const char*> string_event{
+      "ThreadedBench#StringEvent: name"};
+  static wtf::ScopedEventEnabled<int32_t> scope{"ThreadedBench#Scope: i"};
+  static const char* kNames[] = {"alpha", "beta", "gamma", "delta"};
+
+  for (uint64_t i = 0; !stop.load(std::memory_order_relaxed); i++) {
+    bool sample = (i % kSampleInterval) == 0;
+    bool during_save = sample && save_in_progress.load();
+    Clock::time_point start;
+    if (sample) {
+      start = Clock::now();
+    }
+
+    // Rotate through an integer event, a string event (which goes through
+    // the StringTable) and a scope.
+    switch (i % 3) {
+      case 0:
+        event.Invoke(thread_number, i);
+        break;
+      case 1:
+        string_event.Invoke(kNames[i % 4]);
+        break;
+      case 2: {
+        wtf::AutoScopeEnabled<int32_t> auto_scope{scope};
+        auto_scope.Enter(i);
+        break;
+      }
+    }
+
+    if (sample) {
+      uint32_t latency = ElapsedNanos(start);
+      stats->latencies_ns.push_back(latency);
+      if (during_save) {
+        stats->save_latencies_ns.push_back(latency);
+      }
+    }
+    stats->event_count += 1;
+  }
+  wtf::Runtime::GetInstance()->DisableCurrentThread();
+}
+
+void Saver(SaverStats* stats) {
+  NullStreamBuf null_buf;
+  std::ostream out(&null_buf);
+  while (!stop) {
+    save_in_progress = true;
+    auto start = Clock::now();
+    if (!wtf::Runtime::GetInstance()->Save(
+            &out, wtf::Runtime::SaveOptions::ForClear())) {
+      std::fprintf(stderr, "Save() failed\n");
+    }
+    double ms = ElapsedNanos(start) / 1e6;
+    save_in_progress = false;
+    stats->save_count += 1;
+    stats->total_save_ms += ms;
+    stats->max_save_ms = std::max(stats->max_save_ms, ms);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+uint32_t Percentile(std::vector<uint32_t>* values, double p) {
+  if (values->empty()) {
+    return 0;
+  }
+  size_t index = static_cast<size_t>(p * (values->size() - 1));
+  std::nth_element(values->begin(), values->begin() + index, values->end());
+  return (*values)[index];
+}
+
+void RunStep(int thread_count, double seconds) {
+  stop = false;
+  std::vector<WriterStats> writer_stats(thread_count);
+  SaverStats saver_stats;
+
+  auto start = Clock::now();
+  std::thread save_thread(Saver, &saver_stats);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < thread_count; i++) {
+    threads.emplace_back(Writer, i, &writer_stats[i]);
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  save_thread.join();
+  double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+  uint64_t event_count = 0;
+  std::vector<uint32_t> latencies;
+  std::vector<uint32_t> save_latencies;
+  for (auto& stats : writer_stats) {
+    event_count += stats.event_count;
+    latencies.insert(latencies.end(), stats.latencies_ns.begin(),
+                     stats.latencies_ns.end());
+    save_latencies.insert(save_latencies.end(),
+                          stats.save_latencies_ns.begin(),
+                          stats.save_latencies_ns.end());
+  }
+  uint32_t save_max = save_latencies.empty()
+                          ? 0
+                          : *std::max_element(save_latencies.begin(),
+                                              save_latencies.end());
+
+  std::printf("%7d %12.0f %8u %8u %6llu %10.3f %10.3f %10u %10u\n",
+              thread_count, event_count / elapsed,
+              Percentile(&latencies, 0.50), Percentile(&latencies, 0.99),
+              static_cast<unsigned long long>(saver_stats.save_count),
+              saver_stats.save_count
+                  ? saver_stats.total_save_ms / saver_stats.save_count
+                  : 0.0,
+              saver_stats.max_save_ms, Percentile(&save_latencies, 0.99),
+              save_max);
+  std::fflush(stdout);
+
+  // Drop all thread buffers before the next step so that memory does not
+  // accumulate across steps.
+  wtf::Runtime::GetInstance()->ResetForTesting();
+}
+
+}  // namespace
+
+extern "C" int main(int argc, char** argv) {
+  int max_threads = std::max(1u, std::thread::hardware_concurrency());
+  double seconds = 1.0;
+  if (argc > 1) {
+    max_threads = std::atoi(argv[1]);
+  }
+  if (argc > 2) {
+    seconds = std::atof(argv[2]);
+  }
+  if (max_threads < 1 || seconds <= 0) {
+    std::fprintf(stderr, "Usage: %s [max_threads] [seconds_per_step]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::printf("Sweeping 1..%d writer threads, %.2fs per step, latency sampled "
+              "1/%llu events.\n",
+              max_threads, seconds,
+              static_cast<unsigned long long>(kSampleInterval));
+  std::printf("%7s %12s %8s %8s %6s %10s %10s %10s %10s\n", "threads",
+              "events/s", "p50(ns)", "p99(ns)", "saves", "save(ms)",
+              "save_max", "p99@save", "max@save");
+  for (int thread_count = 1;; thread_count *= 2) {
+    thread_count = std::min(thread_count, max_threads);
+    RunStep(thread_count, seconds);
+    if (thread_count == max_threads) {
+      break;
+    }
+  }
+  return 0;
+}
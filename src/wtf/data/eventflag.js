@@ -70,7 +70,15 @@ wtf.data.EventFlag = {
    * If this is combined with the INTERNAL flag then the event is assumed to
    * be a built-in system append event and will have special handling.
    */
-  APPEND_FLOW_DATA: (1 << 6)
+  APPEND_FLOW_DATA: (1 << 6),
+
+  /**
+   * Binary event arguments smaller than 32 bits (bool, int8/uint8 and
+   * int16/uint16) are packed into shared 32-bit slots instead of taking one
+   * each. Each is placed at the next byte offset that is a multiple of its
+   * size and all other arguments start a new slot, as with C struct layout.
+   */
+  PACKED_ARGUMENTS: (1 << 7)
 };
 
 
@@ -95,3 +103,6 @@ goog.exportProperty(
 goog.exportProperty(
     wtf.data.EventFlag, 'APPEND_FLOW_DATA',
     wtf.data.EventFlag.APPEND_FLOW_DATA);
+goog.exportProperty(
+    wtf.data.EventFlag, 'PACKED_ARGUMENTS',
+    wtf.data.EventFlag.PACKED_ARGUMENTS);
@@ -64,7 +64,14 @@ wtf.data.formats.FileFlags = {
   /**
    * Indicates that times in the file are actually counts.
    */
-  TIMES_AS_COUNT: (1 << 1)
+  TIMES_AS_COUNT: (1 << 1),
+
+  /**
+   * Indicates that times in binary event buffers are the low 32 bits of a
+   * nanosecond clock. Each is relative to the previous event in the buffer,
+   * and wtf.trace#timebase events supply the high 32 bits.
+   */
+  HAS_NANOSECOND_TIMES: (1 << 2)
 };
 
 
@@ -82,6 +89,9 @@ wtf.data.formats.FileFlags.toStrings = function(value) {
   if (value & wtf.data.formats.FileFlags.TIMES_AS_COUNT) {
     result.push('times_as_count');
   }
+  if (value & wtf.data.formats.FileFlags.HAS_NANOSECOND_TIMES) {
+    result.push('has_nanosecond_times');
+  }
   return result;
 };
 
@@ -101,6 +111,9 @@ wtf.data.formats.FileFlags.fromStrings = function(value) {
       case 'times_as_count':
         result |= wtf.data.formats.FileFlags.TIMES_AS_COUNT;
         break;
+      case 'has_nanosecond_times':
+        result |= wtf.data.formats.FileFlags.HAS_NANOSECOND_TIMES;
+        break;
     }
   }
   return result;
@@ -81,6 +81,13 @@ wtf.data.Variable.TYPE_MAP_ = {
   'unsigned long': 'uint32',
   'float32': 'float32',
   'float': 'float32',
+  'int64': 'int64',
+  'long long': 'int64',
+  'uint64': 'uint64',
+  'unsigned long long': 'uint64',
+  'float64': 'float64',
+  'double': 'float64',
+  'pointer': 'pointer',
   'ascii': 'ascii',
   'utf8': 'utf8',
   'char': 'char',
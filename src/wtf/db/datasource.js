@@ -212,6 +212,17 @@ wtf.db.DataSource.prototype.hasHighResolutionTimes = function() {
 };
 
 
+/**
+ * Gets a value indicating whether binary event times in the trace are
+ * truncated nanoseconds (see {@see wtf.data.formats.FileFlags}).
+ * @return {boolean} True if the times are truncated nanoseconds.
+ */
+wtf.db.DataSource.prototype.hasNanosecondTimes = function() {
+  goog.asserts.assert(this.isInitialized_);
+  return !!(this.flags_ & wtf.data.formats.FileFlags.HAS_NANOSECOND_TIMES);
+};
+
+
 /**
  * Gets the bitmask of {@see wtf.db.PresentationHint} values that can be used to
  * help a UI decide what to draw.
@@ -348,6 +359,9 @@ goog.exportProperty(
 goog.exportProperty(
     wtf.db.DataSource.prototype, 'hasHighResolutionTimes',
     wtf.db.DataSource.prototype.hasHighResolutionTimes);
+goog.exportProperty(
+    wtf.db.DataSource.prototype, 'hasNanosecondTimes',
+    wtf.db.DataSource.prototype.hasNanosecondTimes);
 goog.exportProperty(
     wtf.db.DataSource.prototype, 'getPresentationHints',
     wtf.db.DataSource.prototype.getPresentationHints);
@@ -14,6 +14,7 @@
 goog.provide('wtf.db.EventTypeBuilder');
 
 goog.require('goog.asserts');
+goog.require('wtf.data.EventFlag');
 goog.require('wtf.util.FunctionBuilder');
 
 
@@ -48,6 +49,10 @@ wtf.db.EventTypeBuilder.prototype.generate = function(eventType) {
 
   this.begin();
   this.addArgument('buffer');
+  this.addScopeVariable('float64Value', wtf.db.EventTypeBuilder.FLOAT64_);
+  this.addScopeVariable('float64Words', wtf.db.EventTypeBuilder.FLOAT64_WORDS_);
+  this.addScopeVariable('getResourceArray',
+      wtf.db.EventTypeBuilder.getResourceArray_);
 
   // Scan arguments to figure out which buffers we need.
   var uses = {};
@@ -82,31 +87,46 @@ wtf.db.EventTypeBuilder.prototype.generate = function(eventType) {
   this.append('var o = buffer.offset >> 2;');
 
   // Parse data arguments.
-  // We track a constant offset from 'o' used when writing things. when we
-  // hit something with variable length (array/etc), we use 'o' to track the
-  // offset and reset our constant back to 0.
+  // We track a constant byte offset from 'o' used when writing things. when
+  // we hit something with variable length (array/etc), we use 'o' to track
+  // the offset and reset our constant back to 0.
+  // Small arguments take a whole 4b slot unless they are packed.
+  var packed = !!(eventType.flags & wtf.data.EventFlag.PACKED_ARGUMENTS);
   var offset = 0;
   for (var n = 0; n < args.length; n++) {
     var arg = args[n];
     var reader = readers[arg.typeName];
 
+    if (packed && reader.readPacked) {
+      // Align to the argument size within the current slot.
+      offset = (offset + reader.size - 1) & ~(reader.size - 1);
+      this.append.apply(this, reader.readPacked(
+          arg.name, 'o + ' + (offset >> 2), offset & 3));
+      offset += reader.size;
+      continue;
+    }
+
+    // Everything else starts a new slot.
+    offset = (offset + 3) & ~3;
+
     // If the first variable sized argument, switch to non-constant mode.
     if (!reader.size && offset) {
-      this.append('o += ' + offset + ';');
+      this.append('o += ' + (offset >> 2) + ';');
       offset = 0;
     }
 
     // Append the variable read.
-    this.append.apply(this, reader.read(arg.name, 'o + ' + offset));
+    this.append.apply(this, reader.read(arg.name, 'o + ' + (offset >> 2)));
 
     // Fixup offset.
     if (reader.size) {
       // Pad out to 4b.
-      offset += (reader.size + 3) >> 2;
+      offset += (reader.size + 3) & ~3;
     }
   }
 
   // Stash back the buffer offset.
+  offset = (offset + 3) >> 2;
   if (offset) {
     this.append('buffer.offset = (o + ' + offset + ') << 2;');
   } else {
@@ -128,12 +148,63 @@ wtf.db.EventTypeBuilder.prototype.generate = function(eventType) {
 };
 
 
+/**
+ * Scratch space for reassembling float64 arguments, which are only 4b
+ * aligned in the buffer.
+ * @type {!Float64Array}
+ * @const
+ * @private
+ */
+wtf.db.EventTypeBuilder.FLOAT64_ = new Float64Array(1);
+
+
+/**
+ * 32-bit words of {@see #FLOAT64_}.
+ * @type {!Uint32Array}
+ * @const
+ * @private
+ */
+wtf.db.EventTypeBuilder.FLOAT64_WORDS_ =
+    new Uint32Array(wtf.db.EventTypeBuilder.FLOAT64_.buffer);
+
+
+/**
+ * Reads an array argument that was stored out of line in a resource.
+ * @param {Array.<wtf.io.BlobData>} resources Resources of the event buffer.
+ * @param {number} id Resource ID.
+ * @param {function(new:ArrayBufferView, !ArrayBuffer, number, number)} ctor
+ *     Typed array constructor.
+ * @return {ArrayBufferView} A copy of the array, or null if the resource is
+ *     missing.
+ * @private
+ */
+wtf.db.EventTypeBuilder.getResourceArray_ = function(resources, id, ctor) {
+  var resource = resources ? resources[id] : null;
+  if (!resource || !resource.buffer) {
+    return null;
+  }
+  var bytes = new Uint8Array(resource.byteLength);
+  bytes.set(new Uint8Array(
+      resource.buffer, resource.byteOffset, resource.byteLength));
+  return new ctor(bytes.buffer, 0,
+      Math.floor(bytes.length / ctor.BYTES_PER_ELEMENT));
+};
+
+
 /**
  * Reader information for supported types.
+ * Arrays whose length is 0xFFFFFFFF are null, and those whose length is
+ * 0xFFFFFFFE are instead followed by the ID of a resource holding their data.
+ * 64-bit types take two slots, low word first. Integers beyond 2^53 lose
+ * precision when converted to numbers; pointers are read as hex strings.
+ * Types smaller than 32 bits also have a readPacked function that takes
+ * the byte offset within the slot, for events with
+ * {@see wtf.data.EventFlag#PACKED_ARGUMENTS}.
  * @type {!Object.<!{
  *   uses: !Array.<string>,
  *   size: number,
- *   read: function(string, (number|string)):(!Array.<string>)
+ *   read: function(string, (number|string)):(!Array.<string>),
+ *   readPacked: (function(string, string, number):(!Array.<string>)|undefined)
  * }>}
  * @private
  */
@@ -145,6 +216,12 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       return [
         'var ' + a + '_ = !!uint8Array[(' + offset + ') << 2];'
       ];
+    },
+    readPacked: function(a, offset, byteOffset) {
+      return [
+        'var ' + a + '_ = !!uint8Array[((' + offset + ') << 2) + ' +
+            byteOffset + '];'
+      ];
     }
   },
   'int8': {
@@ -154,16 +231,25 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       return [
         'var ' + a + '_ = int8Array[(' + offset + ') << 2];'
       ];
+    },
+    readPacked: function(a, offset, byteOffset) {
+      return [
+        'var ' + a + '_ = int8Array[((' + offset + ') << 2) + ' +
+            byteOffset + '];'
+      ];
     }
   },
   'int8[]': {
-    uses: ['uint32Array', 'int8Array', 'temp', 'len'],
+    uses: ['uint32Array', 'int8Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Int8Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Int8Array(len);',
         '  for (var n = 0, oi = o << 2; n < len; n++) {',
         '    temp[n] = int8Array[oi + n];',
@@ -180,16 +266,25 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       return [
         'var ' + a + '_ = uint8Array[(' + offset + ') << 2];'
       ];
+    },
+    readPacked: function(a, offset, byteOffset) {
+      return [
+        'var ' + a + '_ = uint8Array[((' + offset + ') << 2) + ' +
+            byteOffset + '];'
+      ];
     }
   },
   'uint8[]': {
-    uses: ['uint32Array', 'uint8Array', 'temp', 'len'],
+    uses: ['uint32Array', 'uint8Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Uint8Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Uint8Array(len);',
         '  for (var n = 0, oi = o << 2; n < len; n++) {',
         '    temp[n] = uint8Array[oi + n];',
@@ -206,16 +301,25 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       return [
         'var ' + a + '_ = int16Array[(' + offset + ') << 1];'
       ];
+    },
+    readPacked: function(a, offset, byteOffset) {
+      return [
+        'var ' + a + '_ = int16Array[((' + offset + ') << 1) + ' +
+            (byteOffset >> 1) + '];'
+      ];
     }
   },
   'int16[]': {
-    uses: ['uint32Array', 'int16Array', 'temp', 'len'],
+    uses: ['uint32Array', 'int16Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Int16Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Int16Array(len);',
         '  for (var n = 0, oi = o << 1; n < len; n++) {',
         '    temp[n] = int16Array[oi + n];',
@@ -232,16 +336,25 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       return [
         'var ' + a + '_ = uint16Array[(' + offset + ') << 1];'
       ];
+    },
+    readPacked: function(a, offset, byteOffset) {
+      return [
+        'var ' + a + '_ = uint16Array[((' + offset + ') << 1) + ' +
+            (byteOffset >> 1) + '];'
+      ];
     }
   },
   'uint16[]': {
-    uses: ['uint32Array', 'uint16Array', 'temp', 'len'],
+    uses: ['uint32Array', 'uint16Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Uint16Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Uint16Array(len);',
         '  for (var n = 0, oi = o << 1; n < len; n++) {',
         '    temp[n] = uint16Array[oi + n];',
@@ -261,13 +374,16 @@ wtf.db.EventTypeBuilder.READERS_ = ({
     }
   },
   'int32[]': {
-    uses: ['uint32Array', 'int32Array', 'temp', 'len'],
+    uses: ['uint32Array', 'int32Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Int32Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Int32Array(len);',
         '  for (var n = 0; n < len; n++) {',
         '    temp[n] = int32Array[o + n];',
@@ -287,13 +403,16 @@ wtf.db.EventTypeBuilder.READERS_ = ({
     }
   },
   'uint32[]': {
-    uses: ['uint32Array', 'temp', 'len'],
+    uses: ['uint32Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Uint32Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Uint32Array(len);',
         '  for (var n = 0; n < len; n++) {',
         '    temp[n] = uint32Array[o + n];',
@@ -313,13 +432,16 @@ wtf.db.EventTypeBuilder.READERS_ = ({
     }
   },
   'float32[]': {
-    uses: ['uint32Array', 'float32Array', 'temp', 'len'],
+    uses: ['uint32Array', 'float32Array', 'temp', 'len', 'resources'],
     size: 0,
     read: function(a, offset) {
       return [
         'var ' + a + '_ = null;',
         'len = uint32Array[o++];',
-        'if (len != 0xFFFFFFFF) {',
+        'if (len == 0xFFFFFFFE) {',
+        '  ' + a + '_ = getResourceArray(resources, uint32Array[o++], ' +
+            'Float32Array);',
+        '} else if (len != 0xFFFFFFFF) {',
         '  ' + a + '_ = temp = new Float32Array(len);',
         '  for (var n = 0; n < len; n++) {',
         '    temp[n] = float32Array[o + n];',
@@ -329,6 +451,52 @@ wtf.db.EventTypeBuilder.READERS_ = ({
       ];
     }
   },
+  'int64': {
+    uses: ['uint32Array', 'int32Array'],
+    size: 8,
+    read: function(a, offset) {
+      return [
+        'var ' + a + '_ = int32Array[(' + offset + ') + 1] * 4294967296 + ' +
+            'uint32Array[' + offset + '];'
+      ];
+    }
+  },
+  'uint64': {
+    uses: ['uint32Array'],
+    size: 8,
+    read: function(a, offset) {
+      return [
+        'var ' + a + '_ = uint32Array[(' + offset + ') + 1] * 4294967296 + ' +
+            'uint32Array[' + offset + '];'
+      ];
+    }
+  },
+  'float64': {
+    uses: ['uint32Array'],
+    size: 8,
+    read: function(a, offset) {
+      return [
+        'float64Words[0] = uint32Array[' + offset + '];',
+        'float64Words[1] = uint32Array[(' + offset + ') + 1];',
+        'var ' + a + '_ = float64Value[0];'
+      ];
+    }
+  },
+  'pointer': {
+    uses: ['uint32Array'],
+    size: 8,
+    read: function(a, offset) {
+      return [
+        'var ' + a + 'High = uint32Array[(' + offset + ') + 1];',
+        'var ' + a + '_ = uint32Array[' + offset + '].toString(16);',
+        'if (' + a + 'High) {',
+        '  ' + a + '_ = ' + a + 'High.toString(16) + ' +
+            '(\'0000000\' + ' + a + '_).slice(-8);',
+        '}',
+        a + '_ = \'0x\' + ' + a + '_;'
+      ];
+    }
+  },
   'ascii': {
     uses: ['uint32Array', 'stringTable'],
     size: 4,
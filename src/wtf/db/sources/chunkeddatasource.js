@@ -21,6 +21,7 @@ goog.require('wtf.db.EventType');
 goog.require('wtf.db.TimeRange');
 goog.require('wtf.db.Unit');
 goog.require('wtf.io.BufferView');
+goog.require('wtf.io.StringTable');
 goog.require('wtf.io.cff.ChunkType');
 goog.require('wtf.io.cff.PartType');
 goog.require('wtf.io.cff.StreamSource');
@@ -84,6 +85,30 @@ wtf.db.sources.ChunkedDataSource = function(db, sourceInfo, streamSource) {
    */
   this.timeRangeRenames_ = {};
 
+  /**
+   * The high 32 bits of the time carried by a wtf.trace#timebase event that
+   * has just been read from a binary event buffer, or -1 if there is none.
+   * @type {number}
+   * @private
+   */
+  this.binaryTimebaseHigh_ = -1;
+
+  /**
+   * Scratch buffer that compactly encoded arguments are expanded into so that
+   * they can be parsed like binary ones. Grown as needed.
+   * @type {wtf.io.BufferView.Type}
+   * @private
+   */
+  this.compactArgumentBuffer_ = null;
+
+  /**
+   * String tables accumulated from string table delta parts, keyed by the ID
+   * of the chunks that carry them.
+   * @type {!Object.<number, !wtf.io.StringTable>}
+   * @private
+   */
+  this.deltaStringTables_ = {};
+
   /**
    * A fast dispatch table for BUILTIN events, keyed on event name.
    * Each function handles an event of the given type.
@@ -164,6 +189,7 @@ wtf.db.sources.ChunkedDataSource.prototype.chunkReceived_ = function(chunk) {
     case wtf.io.cff.ChunkType.EVENT_DATA:
       var eventDataChunk =
           /** @type {!wtf.io.cff.chunks.EventDataChunk} */ (chunk);
+      this.resolveStringTableDelta_(eventDataChunk);
       var part = eventDataChunk.getEventData();
       goog.asserts.assert(part);
       switch (part.getType()) {
@@ -175,6 +201,10 @@ wtf.db.sources.ChunkedDataSource.prototype.chunkReceived_ = function(chunk) {
           this.processBinaryEventBuffer_(
               /** @type {!wtf.io.cff.parts.BinaryEventBufferPart} */ (part));
           break;
+        case wtf.io.cff.PartType.COMPACT_EVENT_BUFFER:
+          this.processCompactEventBuffer_(
+              /** @type {!wtf.io.cff.parts.CompactEventBufferPart} */ (part));
+          break;
         case wtf.io.cff.PartType.JSON_EVENT_BUFFER:
           this.processJsonEventBuffer_(
               /** @type {!wtf.io.cff.parts.JsonEventBufferPart} */ (part));
@@ -190,6 +220,31 @@ wtf.db.sources.ChunkedDataSource.prototype.chunkReceived_ = function(chunk) {
 };
 
 
+/**
+ * If the chunk carries a string table delta, appends it to the table
+ * accumulated for the chunk ID and has the chunk's events use the result.
+ * @param {!wtf.io.cff.chunks.EventDataChunk} chunk Chunk.
+ * @private
+ */
+wtf.db.sources.ChunkedDataSource.prototype.resolveStringTableDelta_ =
+    function(chunk) {
+  var stringTablePart = chunk.getStringTablePart();
+  if (!stringTablePart || !stringTablePart.isDelta()) {
+    return;
+  }
+  var chunkId = chunk.getId();
+  var stringTable = this.deltaStringTables_[chunkId];
+  if (!stringTable) {
+    stringTable = this.deltaStringTables_[chunkId] = new wtf.io.StringTable();
+  }
+  var delta = stringTablePart.getValue();
+  if (delta) {
+    stringTable.append(delta);
+  }
+  chunk.setStringTable(stringTable);
+};
+
+
 /**
  * Processes incoming file header chunks.
  * @param {!wtf.io.cff.chunks.FileHeaderChunk} chunk Chunk.
@@ -283,6 +338,11 @@ wtf.db.sources.ChunkedDataSource.prototype.setupBinaryDispatchTable_ =
     return true;
   };
 
+  this.binaryDispatch_['wtf.trace#timebase'] = function(eventType, args) {
+    this.binaryTimebaseHigh_ = args['high'];
+    return false;
+  };
+
   // TODO(benvanik): rename flows like time ranges
 };
 
@@ -306,6 +366,9 @@ wtf.db.sources.ChunkedDataSource.prototype.processBinaryEventBuffer_ =
   var offset = 0;
   var capacity = wtf.io.BufferView.getCapacity(bufferView) >> 2;
   wtf.io.BufferView.setOffset(bufferView, 0);
+  var nanosecondTimes = this.hasNanosecondTimes();
+  var timeNanos = 0;
+  this.binaryTimebaseHigh_ = -1;
   while (offset < capacity) {
     // Read common event header.
     var eventWireId = uint32Array[offset + 0];
@@ -339,6 +402,18 @@ wtf.db.sources.ChunkedDataSource.prototype.processBinaryEventBuffer_ =
       }
     }
 
+    if (nanosecondTimes) {
+      // Unwrap the low 32 bits against the previous event, unless a timebase
+      // has just supplied the high bits. The database holds microseconds.
+      if (this.binaryTimebaseHigh_ >= 0) {
+        timeNanos = this.binaryTimebaseHigh_ * 4294967296 + time;
+        this.binaryTimebaseHigh_ = -1;
+      } else {
+        timeNanos += (time - timeNanos % 4294967296) >>> 0;
+      }
+      time = Math.floor(timeNanos / 1000);
+    }
+
     if (insertEvent) {
       var eventList = this.currentZone_.getEventList();
       eventList.insert(
@@ -350,6 +425,111 @@ wtf.db.sources.ChunkedDataSource.prototype.processBinaryEventBuffer_ =
 };
 
 
+/**
+ * Processes incoming event data chunks in the compact (varint) format.
+ * See {@see wtf.io.cff.parts.CompactEventBufferPart} for the encoding. Times
+ * are always in nanoseconds.
+ * @param {!wtf.io.cff.parts.CompactEventBufferPart} part Part.
+ * @private
+ */
+wtf.db.sources.ChunkedDataSource.prototype.processCompactEventBuffer_ =
+    function(part) {
+  var bytes = part.getValue();
+  goog.asserts.assert(bytes);
+
+  var argumentBuffer = this.compactArgumentBuffer_;
+  if (!argumentBuffer) {
+    argumentBuffer = this.compactArgumentBuffer_ =
+        wtf.io.BufferView.createEmpty(1024);
+  }
+  wtf.io.BufferView.setStringTable(
+      argumentBuffer, part.getStringTable() || new wtf.io.StringTable());
+  wtf.io.BufferView.setResources(argumentBuffer, part.getResources());
+
+  // Reads a varint. Values are at most 53 bits (times and 32-bit slots), so
+  // this avoids bitwise operations, which truncate to 32 bits.
+  var offset = 0;
+  var readVarint = function() {
+    var value = 0;
+    var scale = 1;
+    var b;
+    do {
+      b = bytes[offset++];
+      value += (b & 0x7f) * scale;
+      scale *= 128;
+    } while (b & 0x80);
+    return value;
+  };
+
+  var eventWireTable = this.eventWireTable_;
+  var length = bytes.length;
+  var timeNanos = 0;
+  while (offset < length) {
+    // Read common event header.
+    var header = readVarint();
+    var eventWireId = Math.floor(header / 16);
+    var argumentCount = header % 16;
+    if (argumentCount == 15) {
+      argumentCount = readVarint();
+    }
+    timeNanos += readVarint();
+
+    // Expand argument slots.
+    if (argumentCount * 4 > wtf.io.BufferView.getCapacity(argumentBuffer)) {
+      var stringTable = wtf.io.BufferView.getStringTable(argumentBuffer);
+      argumentBuffer = this.compactArgumentBuffer_ =
+          wtf.io.BufferView.createEmpty(argumentCount * 4);
+      wtf.io.BufferView.setStringTable(argumentBuffer, stringTable);
+      wtf.io.BufferView.setResources(argumentBuffer, part.getResources());
+    }
+    var uint32Array = argumentBuffer['uint32Array'];
+    for (var n = 0; n < argumentCount; n++) {
+      uint32Array[n] = readVarint();
+    }
+
+    // Lookup event.
+    var eventType = eventWireTable[eventWireId];
+    if (!eventType) {
+      this.error(
+          'Undefined event type',
+          'The file tried to reference an event it didn\'t define. Perhaps ' +
+          'it\'s corrupted?');
+      break;
+    }
+
+    // Timebases carry the full time as (low, high) argument slots.
+    if (eventType.name == 'wtf.trace#timebase') {
+      timeNanos = uint32Array[1] * 4294967296 + uint32Array[0];
+      continue;
+    }
+
+    // Parse argument data, if it exists.
+    var args = null;
+    if (eventType.parseBinaryArguments) {
+      wtf.io.BufferView.setOffset(argumentBuffer, 0);
+      args = eventType.parseBinaryArguments(argumentBuffer);
+    }
+
+    // Handle built-in events.
+    var insertEvent = true;
+    if (eventType.flags & wtf.data.EventFlag.BUILTIN) {
+      var dispatchFn = this.binaryDispatch_[eventType.name];
+      if (dispatchFn) {
+        insertEvent = dispatchFn.call(this, eventType, args);
+      }
+    }
+
+    if (insertEvent) {
+      var eventList = this.currentZone_.getEventList();
+      eventList.insert(
+          eventType,
+          Math.max(0, Math.floor(timeNanos / 1000) + this.getTimeDelay()),
+          args);
+    }
+  }
+};
+
+
 /**
  * Processes incoming event data chunks in the legacy binary format.
  * @param {!wtf.io.cff.parts.LegacyEventBufferPart} part Part.
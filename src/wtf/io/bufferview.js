@@ -38,6 +38,7 @@ goog.require('wtf.io.StringTable');
  *   capacity: number,
  *   offset: number,
  *   stringTable: !wtf.io.StringTable,
+ *   resources: Array.<wtf.io.BlobData>,
  *   arrayBuffer: !ArrayBuffer,
  *   int8Array: !Int8Array,
  *   uint8Array: !Uint8Array,
@@ -88,6 +89,7 @@ wtf.io.BufferView.createWithBuffer = function(arrayBuffer, opt_stringTable) {
     'capacity': arrayBuffer.byteLength,
     'offset': 0,
     'stringTable': opt_stringTable || new wtf.io.StringTable(),
+    'resources': null,
     'arrayBuffer': arrayBuffer,
     'int8Array': new Int8Array(arrayBuffer),
     'uint8Array': new Uint8Array(arrayBuffer),
@@ -173,6 +175,27 @@ wtf.io.BufferView.setStringTable = function(bufferView, value) {
 };
 
 
+/**
+ * Gets the resources that array arguments in the given buffer view may be
+ * stored in, indexed by resource ID.
+ * @param {!wtf.io.BufferView.Type} bufferView Buffer view.
+ * @return {Array.<wtf.io.BlobData>} Resources, if any.
+ */
+wtf.io.BufferView.getResources = function(bufferView) {
+  return bufferView['resources'];
+};
+
+
+/**
+ * Sets the resources of the given buffer view.
+ * @param {!wtf.io.BufferView.Type} bufferView Buffer view.
+ * @param {Array.<wtf.io.BlobData>} value Resources, indexed by resource ID.
+ */
+wtf.io.BufferView.setResources = function(bufferView, value) {
+  bufferView['resources'] = value;
+};
+
+
 /**
  * Resets the buffer offset to the start and clears its string table.
  * @param {!wtf.io.BufferView.Type} bufferView Buffer view.
@@ -20,6 +20,7 @@ goog.require('wtf.io.cff.ChunkType');
 goog.require('wtf.io.cff.PartType');
 goog.require('wtf.io.cff.parts.BinaryEventBufferPart');
 goog.require('wtf.io.cff.parts.BinaryResourcePart');
+goog.require('wtf.io.cff.parts.CompactEventBufferPart');
 goog.require('wtf.io.cff.parts.JsonEventBufferPart');
 goog.require('wtf.io.cff.parts.LegacyEventBufferPart');
 goog.require('wtf.io.cff.parts.StringResourcePart');
@@ -40,6 +41,7 @@ wtf.io.cff.chunks.EventDataChunk = function(opt_chunkId) {
   /**
    * Event data buffer part.
    * @type {wtf.io.cff.parts.BinaryEventBufferPart|
+   *     wtf.io.cff.parts.CompactEventBufferPart|
    *     wtf.io.cff.parts.JsonEventBufferPart|
    *     wtf.io.cff.parts.LegacyEventBufferPart}
    * @private
@@ -59,6 +61,13 @@ wtf.io.cff.chunks.EventDataChunk = function(opt_chunkId) {
    * @private
    */
   this.resourceParts_ = [];
+
+  /**
+   * ID of the first embedded resource part, from a resource base part.
+   * @type {number}
+   * @private
+   */
+  this.resourceBase_ = 0;
 };
 goog.inherits(wtf.io.cff.chunks.EventDataChunk, wtf.io.cff.Chunk);
 
@@ -75,6 +84,7 @@ wtf.io.cff.chunks.EventDataChunk.prototype.load = function(parts) {
     this.addPart(part);
     switch (part.getType()) {
       case wtf.io.cff.PartType.STRING_TABLE:
+      case wtf.io.cff.PartType.STRING_TABLE_DELTA:
         this.stringTablePart_ =
             /** @type {!wtf.io.cff.parts.StringTablePart} */ (part);
         break;
@@ -90,6 +100,10 @@ wtf.io.cff.chunks.EventDataChunk.prototype.load = function(parts) {
         this.eventBufferPart_ =
             /** @type {!wtf.io.cff.parts.BinaryEventBufferPart} */ (part);
         break;
+      case wtf.io.cff.PartType.COMPACT_EVENT_BUFFER:
+        this.eventBufferPart_ =
+            /** @type {!wtf.io.cff.parts.CompactEventBufferPart} */ (part);
+        break;
       case wtf.io.cff.PartType.STRING_RESOURCE:
         this.resourceParts_.push(
             /** @type {!wtf.io.cff.parts.StringResourcePart} */ (part));
@@ -98,6 +112,13 @@ wtf.io.cff.chunks.EventDataChunk.prototype.load = function(parts) {
         this.resourceParts_.push(
             /** @type {!wtf.io.cff.parts.BinaryResourcePart} */ (part));
         break;
+      case wtf.io.cff.PartType.RESOURCE_BASE:
+        var base = /** @type {!wtf.io.cff.parts.BinaryResourcePart} */ (
+            part).getValue();
+        goog.asserts.assert(base.byteLength == 4);
+        this.resourceBase_ = (base[0] | (base[1] << 8) | (base[2] << 16) |
+            (base[3] << 24)) >>> 0;
+        break;
       default:
         goog.asserts.fail('Unknown part type: ' + part.getType());
         throw new Error('Unknown part type ' + part.getType() + ' in chunk.');
@@ -110,13 +131,27 @@ wtf.io.cff.chunks.EventDataChunk.prototype.load = function(parts) {
   }
 
   // Wire up string table, if needed.
-  if (this.stringTablePart_ &&
-      this.eventBufferPart_ instanceof wtf.io.cff.parts.BinaryEventBufferPart) {
-    var bufferView = this.eventBufferPart_.getValue();
-    goog.asserts.assert(bufferView);
+  if (this.stringTablePart_) {
     var stringTable = this.stringTablePart_.getValue();
     goog.asserts.assert(stringTable);
-    wtf.io.BufferView.setStringTable(bufferView, stringTable);
+    this.setStringTable(stringTable);
+  }
+
+  // Wire up resources, which large array arguments are stored in, indexed by
+  // resource ID.
+  if (this.resourceParts_.length) {
+    var resources = [];
+    for (var n = 0; n < this.resourceParts_.length; n++) {
+      resources[this.resourceBase_ + n] = this.resourceParts_[n].getValue();
+    }
+    if (this.eventBufferPart_ instanceof
+        wtf.io.cff.parts.BinaryEventBufferPart) {
+      wtf.io.BufferView.setResources(
+          this.eventBufferPart_.getValue(), resources);
+    } else if (this.eventBufferPart_ instanceof
+        wtf.io.cff.parts.CompactEventBufferPart) {
+      this.eventBufferPart_.setResources(resources);
+    }
   }
 };
 
@@ -172,6 +207,34 @@ wtf.io.cff.chunks.EventDataChunk.prototype.getEventData = function() {
 };
 
 
+/**
+ * Gets the string table part, if any.
+ * @return {wtf.io.cff.parts.StringTablePart} String table part.
+ */
+wtf.io.cff.chunks.EventDataChunk.prototype.getStringTablePart = function() {
+  return this.stringTablePart_;
+};
+
+
+/**
+ * Sets the string table that events in the event data buffer refer to.
+ * Used in place of the chunk's own table when that is a delta.
+ * @param {!wtf.io.StringTable} stringTable String table.
+ */
+wtf.io.cff.chunks.EventDataChunk.prototype.setStringTable = function(
+    stringTable) {
+  if (this.eventBufferPart_ instanceof
+      wtf.io.cff.parts.BinaryEventBufferPart) {
+    var bufferView = this.eventBufferPart_.getValue();
+    goog.asserts.assert(bufferView);
+    wtf.io.BufferView.setStringTable(bufferView, stringTable);
+  } else if (this.eventBufferPart_ instanceof
+      wtf.io.cff.parts.CompactEventBufferPart) {
+    this.eventBufferPart_.setStringTable(stringTable);
+  }
+};
+
+
 /**
  * Gets the event data buffer, assuming it's a binary buffer.
  * This is a convience method and callers must ensure it's only made when the
@@ -204,7 +267,7 @@ wtf.io.cff.chunks.EventDataChunk.prototype.addResource = function(data) {
   }
   this.addPart(part);
   this.resourceParts_.push(part);
-  return this.resourceParts_.length;
+  return this.resourceParts_.length - 1;
 };
 
 
@@ -214,7 +277,7 @@ wtf.io.cff.chunks.EventDataChunk.prototype.addResource = function(data) {
  * @return {wtf.io.BlobData} Resource, if found.
  */
 wtf.io.cff.chunks.EventDataChunk.prototype.getResource = function(id) {
-  var part = this.resourceParts_[id];
+  var part = this.resourceParts_[id - this.resourceBase_];
   return part ? part.getValue() : null;
 };
 
@@ -226,6 +289,7 @@ wtf.io.cff.chunks.EventDataChunk.prototype.reset = function() {
   // Remove all unneeded parts.
   this.removeAllParts();
   this.resourceParts_ = [];
+  this.resourceBase_ = 0;
 
   // Add back valid parts.
   if (this.stringTablePart_) {
@@ -241,6 +305,12 @@ wtf.io.cff.chunks.EventDataChunk.prototype.reset = function() {
       var bufferView = part.getValue();
       goog.asserts.assert(bufferView);
       wtf.io.BufferView.reset(bufferView);
+    } else if (part instanceof wtf.io.cff.parts.CompactEventBufferPart) {
+      part.setValue(new Uint8Array(0));
+      var stringTable = part.getStringTable();
+      if (stringTable) {
+        stringTable.reset();
+      }
     } else if (part instanceof wtf.io.cff.parts.JsonEventBufferPart) {
       part.setValue([]);
     } else if (part instanceof wtf.io.cff.parts.LegacyEventBufferPart) {
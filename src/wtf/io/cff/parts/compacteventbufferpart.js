@@ -0,0 +1,170 @@
+/**
+ * Copyright 2026 Google, Inc. All Rights Reserved.
+ *
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/**
+ * @fileoverview Compact (varint encoded) event data buffer chunk part.
+ */
+
+goog.provide('wtf.io.cff.parts.CompactEventBufferPart');
+
+goog.require('goog.asserts');
+goog.require('wtf.io');
+goog.require('wtf.io.StringTable');
+goog.require('wtf.io.cff.Part');
+goog.require('wtf.io.cff.PartType');
+
+
+
+/**
+ * A part containing compactly encoded event data.
+ * Each event is a sequence of little endian base 128 varints:
+ * <code>(wireId << 4) | min(argSlotCount, 15)</code>, then argSlotCount if it
+ * is 15 or more, then the nanoseconds elapsed since the previous event, then
+ * one 32-bit value per argument slot. A wtf.trace#timebase event instead has
+ * two argument slots (the low and high 32 bits of a nanosecond time) that the
+ * running time is reset to.
+ *
+ * Unlike binary event buffers the data need not fill the last 32-bit word,
+ * so it is kept as bytes.
+ *
+ * @param {Uint8Array=} opt_value Initial event data.
+ * @constructor
+ * @extends {wtf.io.cff.Part}
+ */
+wtf.io.cff.parts.CompactEventBufferPart = function(opt_value) {
+  goog.base(this, wtf.io.cff.PartType.COMPACT_EVENT_BUFFER);
+
+  /**
+   * Event data.
+   * @type {Uint8Array}
+   * @private
+   */
+  this.value_ = opt_value || null;
+
+  /**
+   * String table that string arguments are resolved against.
+   * @type {wtf.io.StringTable}
+   * @private
+   */
+  this.stringTable_ = null;
+
+  /**
+   * Resources that array arguments may be stored in.
+   * @type {Array.<wtf.io.BlobData>}
+   * @private
+   */
+  this.resources_ = null;
+};
+goog.inherits(wtf.io.cff.parts.CompactEventBufferPart, wtf.io.cff.Part);
+
+
+/**
+ * Gets the event data.
+ * @return {Uint8Array} Event data, if any.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.getValue = function() {
+  return this.value_;
+};
+
+
+/**
+ * Sets the event data.
+ * @param {Uint8Array} value Event data.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.setValue = function(value) {
+  this.value_ = value;
+};
+
+
+/**
+ * Gets the string table that string arguments are resolved against.
+ * @return {wtf.io.StringTable} String table, if any.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.getStringTable =
+    function() {
+  return this.stringTable_;
+};
+
+
+/**
+ * Sets the string table that string arguments are resolved against.
+ * @param {wtf.io.StringTable} value String table.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.setStringTable =
+    function(value) {
+  this.stringTable_ = value;
+};
+
+
+/**
+ * Gets the resources that array arguments may be stored in.
+ * @return {Array.<wtf.io.BlobData>} Resources, indexed by resource ID.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.getResources = function() {
+  return this.resources_;
+};
+
+
+/**
+ * Sets the resources that array arguments may be stored in.
+ * @param {Array.<wtf.io.BlobData>} value Resources, indexed by resource ID.
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.setResources =
+    function(value) {
+  this.resources_ = value;
+};
+
+
+/**
+ * @override
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.initFromBlobData =
+    function(data) {
+  // NOTE: we are cloning so that we don't hang on to the full buffer forever.
+  this.value_ = new Uint8Array(data);
+};
+
+
+/**
+ * @override
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.toBlobData = function() {
+  goog.asserts.assert(this.value_);
+  return this.value_;
+};
+
+
+/**
+ * @override
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.initFromJsonObject =
+    function(value) {
+  switch (value['mode']) {
+    case 'base64':
+      var byteLength = value['byteLength'] || 0;
+      var bytes = wtf.io.createByteArray(byteLength);
+      wtf.io.stringToByteArray(value['value'], bytes);
+      this.value_ = bytes;
+      break;
+    default:
+      throw 'JSON mode event data is not supported yet.';
+  }
+};
+
+
+/**
+ * @override
+ */
+wtf.io.cff.parts.CompactEventBufferPart.prototype.toJsonObject = function() {
+  goog.asserts.assert(this.value_);
+  return {
+    'type': this.getType(),
+    'mode': 'base64',
+    'byteLength': this.value_.length,
+    'value': wtf.io.byteArrayToString(this.value_)
+  };
+};
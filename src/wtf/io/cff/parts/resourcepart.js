@@ -126,13 +126,18 @@ wtf.io.cff.parts.StringResourcePart.prototype.toJsonObject = function() {
 
 /**
  * Binary embedded data resource part.
+ * A {@code RESOURCE_BASE} part instead holds the little endian uint32 ID of
+ * the first resource part that follows it in the chunk, when that is not 0
+ * because the writer has freed earlier resources.
  *
  * @param {(wtf.io.Blob|Blob|ArrayBufferView)=} opt_value Initial value.
+ * @param {wtf.io.cff.PartType=} opt_type Part type, either
+ *     {@code BINARY_RESOURCE} (the default) or {@code RESOURCE_BASE}.
  * @constructor
  * @extends {wtf.io.cff.parts.ResourcePart}
  */
-wtf.io.cff.parts.BinaryResourcePart = function(opt_value) {
-  goog.base(this, wtf.io.cff.PartType.BINARY_RESOURCE);
+wtf.io.cff.parts.BinaryResourcePart = function(opt_value, opt_type) {
+  goog.base(this, opt_type || wtf.io.cff.PartType.BINARY_RESOURCE);
 
   /**
    * Resource value.
@@ -164,6 +169,15 @@ wtf.io.cff.parts.BinaryResourcePart.prototype.setValue = function(value) {
 };
 
 
+/**
+ * Whether the part holds the ID of the first resource in its chunk.
+ * @return {boolean} True if the part is a resource base.
+ */
+wtf.io.cff.parts.BinaryResourcePart.prototype.isBase = function() {
+  return this.getType() == wtf.io.cff.PartType.RESOURCE_BASE;
+};
+
+
 /**
  * @override
  */
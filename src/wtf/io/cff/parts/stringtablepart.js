@@ -24,13 +24,18 @@ goog.require('wtf.io.cff.PartType');
 
 /**
  * A part containing a string table.
+ * A {@code STRING_TABLE_DELTA} part holds only the strings added to the table
+ * since the previous event data chunk with the same chunk ID, and the events
+ * of its chunk refer to the combined table.
  *
  * @param {wtf.io.StringTable=} opt_value Initial string table data.
+ * @param {wtf.io.cff.PartType=} opt_type Part type, either
+ *     {@code STRING_TABLE} (the default) or {@code STRING_TABLE_DELTA}.
  * @constructor
  * @extends {wtf.io.cff.Part}
  */
-wtf.io.cff.parts.StringTablePart = function(opt_value) {
-  goog.base(this, wtf.io.cff.PartType.STRING_TABLE);
+wtf.io.cff.parts.StringTablePart = function(opt_value, opt_type) {
+  goog.base(this, opt_type || wtf.io.cff.PartType.STRING_TABLE);
 
   /**
    * String table.
@@ -51,6 +56,15 @@ wtf.io.cff.parts.StringTablePart.prototype.getValue = function() {
 };
 
 
+/**
+ * Whether the part is a delta continuing a previous table.
+ * @return {boolean} True if the part is a delta.
+ */
+wtf.io.cff.parts.StringTablePart.prototype.isDelta = function() {
+  return this.getType() == wtf.io.cff.PartType.STRING_TABLE_DELTA;
+};
+
+
 /**
  * Sets the string table data.
  * @param {wtf.io.StringTable} value String table data.
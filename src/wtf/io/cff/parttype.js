@@ -30,12 +30,18 @@ wtf.io.cff.PartType = {
   LEGACY_EVENT_BUFFER: 'legacy_event_buffer',
   /** {@see wtf.io.cff.parts.BinaryEventBufferPart} */
   BINARY_EVENT_BUFFER: 'binary_event_buffer',
+  /** {@see wtf.io.cff.parts.CompactEventBufferPart} */
+  COMPACT_EVENT_BUFFER: 'compact_event_buffer',
   /** {@see wtf.io.cff.parts.StringTablePart} */
   STRING_TABLE: 'string_table',
+  /** {@see wtf.io.cff.parts.StringTablePart} */
+  STRING_TABLE_DELTA: 'string_table_delta',
   /** {@see wtf.io.cff.parts.BinaryResourcePart} */
   BINARY_RESOURCE: 'binary_resource',
   /** {@see wtf.io.cff.parts.StringResourcePart} */
   STRING_RESOURCE: 'string_resource',
+  /** {@see wtf.io.cff.parts.BinaryResourcePart} */
+  RESOURCE_BASE: 'resource_base',
 
   UNKNOWN: 'unknown_type'
 };
@@ -52,9 +58,12 @@ wtf.io.cff.PartType.isValid = function(value) {
     case wtf.io.cff.PartType.JSON_EVENT_BUFFER:
     case wtf.io.cff.PartType.LEGACY_EVENT_BUFFER:
     case wtf.io.cff.PartType.BINARY_EVENT_BUFFER:
+    case wtf.io.cff.PartType.COMPACT_EVENT_BUFFER:
     case wtf.io.cff.PartType.STRING_TABLE:
+    case wtf.io.cff.PartType.STRING_TABLE_DELTA:
     case wtf.io.cff.PartType.BINARY_RESOURCE:
     case wtf.io.cff.PartType.STRING_RESOURCE:
+    case wtf.io.cff.PartType.RESOURCE_BASE:
       return true;
   }
   return false;
@@ -72,9 +81,12 @@ wtf.io.cff.IntegerPartType_ = {
   JSON_EVENT_BUFFER: 0x20000,
   LEGACY_EVENT_BUFFER: 0x20001,
   BINARY_EVENT_BUFFER: 0x20002,
+  COMPACT_EVENT_BUFFER: 0x20003,
   STRING_TABLE: 0x30000,
+  STRING_TABLE_DELTA: 0x30001,
   BINARY_RESOURCE: 0x40000,
   STRING_RESOURCE: 0x40001,
+  RESOURCE_BASE: 0x40002,
 
   UNKNOWN: -1
 };
@@ -95,12 +107,18 @@ wtf.io.cff.PartType.toInteger = function(value) {
       return wtf.io.cff.IntegerPartType_.LEGACY_EVENT_BUFFER;
     case wtf.io.cff.PartType.BINARY_EVENT_BUFFER:
       return wtf.io.cff.IntegerPartType_.BINARY_EVENT_BUFFER;
+    case wtf.io.cff.PartType.COMPACT_EVENT_BUFFER:
+      return wtf.io.cff.IntegerPartType_.COMPACT_EVENT_BUFFER;
     case wtf.io.cff.PartType.STRING_TABLE:
       return wtf.io.cff.IntegerPartType_.STRING_TABLE;
+    case wtf.io.cff.PartType.STRING_TABLE_DELTA:
+      return wtf.io.cff.IntegerPartType_.STRING_TABLE_DELTA;
     case wtf.io.cff.PartType.BINARY_RESOURCE:
       return wtf.io.cff.IntegerPartType_.BINARY_RESOURCE;
     case wtf.io.cff.PartType.STRING_RESOURCE:
       return wtf.io.cff.IntegerPartType_.STRING_RESOURCE;
+    case wtf.io.cff.PartType.RESOURCE_BASE:
+      return wtf.io.cff.IntegerPartType_.RESOURCE_BASE;
     default:
       goog.asserts.fail('Unknown part type: ' + value);
       return wtf.io.cff.IntegerPartType_.UNKNOWN;
@@ -123,12 +141,18 @@ wtf.io.cff.PartType.fromInteger = function(value) {
       return wtf.io.cff.PartType.LEGACY_EVENT_BUFFER;
     case wtf.io.cff.IntegerPartType_.BINARY_EVENT_BUFFER:
       return wtf.io.cff.PartType.BINARY_EVENT_BUFFER;
+    case wtf.io.cff.IntegerPartType_.COMPACT_EVENT_BUFFER:
+      return wtf.io.cff.PartType.COMPACT_EVENT_BUFFER;
     case wtf.io.cff.IntegerPartType_.STRING_TABLE:
       return wtf.io.cff.PartType.STRING_TABLE;
+    case wtf.io.cff.IntegerPartType_.STRING_TABLE_DELTA:
+      return wtf.io.cff.PartType.STRING_TABLE_DELTA;
     case wtf.io.cff.IntegerPartType_.BINARY_RESOURCE:
       return wtf.io.cff.PartType.BINARY_RESOURCE;
     case wtf.io.cff.IntegerPartType_.STRING_RESOURCE:
       return wtf.io.cff.PartType.STRING_RESOURCE;
+    case wtf.io.cff.IntegerPartType_.RESOURCE_BASE:
+      return wtf.io.cff.PartType.RESOURCE_BASE;
     default:
       goog.asserts.fail('Unknown part type: ' + value);
       return wtf.io.cff.PartType.UNKNOWN;
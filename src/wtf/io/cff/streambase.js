@@ -21,6 +21,7 @@ goog.require('wtf.io.cff.chunks.EventDataChunk');
 goog.require('wtf.io.cff.chunks.FileHeaderChunk');
 goog.require('wtf.io.cff.parts.BinaryEventBufferPart');
 goog.require('wtf.io.cff.parts.BinaryResourcePart');
+goog.require('wtf.io.cff.parts.CompactEventBufferPart');
 goog.require('wtf.io.cff.parts.FileHeaderPart');
 goog.require('wtf.io.cff.parts.JsonEventBufferPart');
 goog.require('wtf.io.cff.parts.LegacyEventBufferPart');
@@ -78,12 +79,20 @@ wtf.io.cff.StreamBase.prototype.createPartType = function(partType) {
       return new wtf.io.cff.parts.LegacyEventBufferPart();
     case wtf.io.cff.PartType.BINARY_EVENT_BUFFER:
       return new wtf.io.cff.parts.BinaryEventBufferPart();
+    case wtf.io.cff.PartType.COMPACT_EVENT_BUFFER:
+      return new wtf.io.cff.parts.CompactEventBufferPart();
     case wtf.io.cff.PartType.STRING_TABLE:
       return new wtf.io.cff.parts.StringTablePart();
+    case wtf.io.cff.PartType.STRING_TABLE_DELTA:
+      return new wtf.io.cff.parts.StringTablePart(
+          undefined, wtf.io.cff.PartType.STRING_TABLE_DELTA);
     case wtf.io.cff.PartType.BINARY_RESOURCE:
       return new wtf.io.cff.parts.BinaryResourcePart();
     case wtf.io.cff.PartType.STRING_RESOURCE:
       return new wtf.io.cff.parts.StringResourcePart();
+    case wtf.io.cff.PartType.RESOURCE_BASE:
+      return new wtf.io.cff.parts.BinaryResourcePart(
+          undefined, wtf.io.cff.PartType.RESOURCE_BASE);
     default:
       goog.asserts.fail('Unhandled part type: ' + partType);
       return null;
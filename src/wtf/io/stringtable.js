@@ -78,6 +78,27 @@ wtf.io.StringTable.prototype.addString = function(value) {
 };
 
 
+/**
+ * Appends all strings of another table, so that they continue this table's
+ * ordinals. Empty strings at the end of a deserialized table are the
+ * terminator and alignment padding and are not appended.
+ * @param {!wtf.io.StringTable} other String table.
+ */
+wtf.io.StringTable.prototype.append = function(other) {
+  var values = other.values_;
+  var step = other.hasNullTerminators_ ? 2 : 1;
+  var length = values.length;
+  if (!other.hasNullTerminators_) {
+    while (length && !values[length - 1]) {
+      length--;
+    }
+  }
+  for (var n = 0; n < length; n += step) {
+    this.addString(values[n]);
+  }
+};
+
+
 /**
  * Gets a string from the table.
  * @param {number} ordinal Ordinal.
@@ -60,6 +60,9 @@ wtf.trace.EventTypeBuilder.prototype.generate = function(context, eventType) {
   this.addScopeVariable('context', context);
   this.addScopeVariable('eventType', eventType);
   this.addScopeVariable('now', wtf.now);
+  this.addScopeVariable('float64Value', wtf.trace.EventTypeBuilder.FLOAT64_);
+  this.addScopeVariable('float64Words',
+      wtf.trace.EventTypeBuilder.FLOAT64_WORDS_);
   this.addScopeVariable('stringify', function(value) {
     // TODO(benvanik): make this even faster.
     var json = null;
@@ -112,8 +115,7 @@ wtf.trace.EventTypeBuilder.prototype.generate = function(context, eventType) {
 
     // Track minimum size.
     if (writer.size) {
-      minSize += writer.size < 4 ?
-          (writer.size + (4 - (writer.size % 4))) : 4;
+      minSize += (writer.size + 3) & ~3;
     }
 
     // If variable size, get the expression.
@@ -376,6 +378,66 @@ wtf.trace.EventTypeBuilder.WRITE_INT32ARRAY_ = ({
 });
 
 
+/**
+ * Writes a number as two slots, low word first. Used for int64, uint64 and
+ * pointer arguments.
+ * @type {wtf.trace.EventTypeBuilder.Writer_}
+ * @private
+ */
+wtf.trace.EventTypeBuilder.WRITE_INT64_ = ({
+  uses: ['int32Array'],
+  size: 8,
+  setup: null,
+  computeSize: null,
+  write: function(a, offset) {
+    return [
+      'var ' + a + 'High = Math.floor(' + a + ' / 4294967296);',
+      'int32Array[' + offset + '] = ' + a + ' - ' + a + 'High * 4294967296;',
+      'int32Array[(' + offset + ') + 1] = ' + a + 'High;'
+    ];
+  }
+});
+
+
+/**
+ * Scratch space for splitting float64 arguments, which are only 4b aligned
+ * in the buffer.
+ * @type {!Float64Array}
+ * @const
+ * @private
+ */
+wtf.trace.EventTypeBuilder.FLOAT64_ = new Float64Array(1);
+
+
+/**
+ * 32-bit words of {@see #FLOAT64_}.
+ * @type {!Int32Array}
+ * @const
+ * @private
+ */
+wtf.trace.EventTypeBuilder.FLOAT64_WORDS_ =
+    new Int32Array(wtf.trace.EventTypeBuilder.FLOAT64_.buffer);
+
+
+/**
+ * @type {wtf.trace.EventTypeBuilder.Writer_}
+ * @private
+ */
+wtf.trace.EventTypeBuilder.WRITE_FLOAT64_ = ({
+  uses: ['int32Array'],
+  size: 8,
+  setup: null,
+  computeSize: null,
+  write: function(a, offset) {
+    return [
+      'float64Value[0] = ' + a + ';',
+      'int32Array[' + offset + '] = float64Words[0];',
+      'int32Array[(' + offset + ') + 1] = float64Words[1];'
+    ];
+  }
+});
+
+
 /**
  * @type {wtf.trace.EventTypeBuilder.Writer_}
  * @private
@@ -610,6 +672,10 @@ wtf.trace.EventTypeBuilder.WRITERS_ = {
   'uint32[]': wtf.trace.EventTypeBuilder.WRITE_INT32ARRAY_,
   'float32': wtf.trace.EventTypeBuilder.WRITE_FLOAT32_,
   'float32[]': wtf.trace.EventTypeBuilder.WRITE_FLOAT32ARRAY_,
+  'int64': wtf.trace.EventTypeBuilder.WRITE_INT64_,
+  'uint64': wtf.trace.EventTypeBuilder.WRITE_INT64_,
+  'float64': wtf.trace.EventTypeBuilder.WRITE_FLOAT64_,
+  'pointer': wtf.trace.EventTypeBuilder.WRITE_INT64_,
   'ascii': wtf.trace.EventTypeBuilder.WRITE_STRING_,
   'utf8': wtf.trace.EventTypeBuilder.WRITE_STRING_,
   'char': wtf.trace.EventTypeBuilder.WRITE_CHAR_,